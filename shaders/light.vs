@@ -7,12 +7,16 @@ layout (location = 2) in vec3 aTexCoord;
 out vec3 Normal;
 out vec3 FragPos;
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+#include "transform.glsl"
+
+layout (std140) uniform Camera {
+    mat4 view;
+    mat4 projection;
+};
 
 void main() {
-    gl_Position = projection * view * model * vec4(aPos, 1.0f);
-    FragPos = vec3(view * model * vec4(aPos, 1.0)); // fragment position in view coordinates
-    Normal = mat3(transpose(inverse(view * model))) * aNormal;
+    vec4 viewPosition = modelView * vec4(aPos, 1.0f);
+    gl_Position = projection * viewPosition;
+    FragPos = vec3(viewPosition); // fragment position in view coordinates
+    Normal = normalMatrix * aNormal;
 }
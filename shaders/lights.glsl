@@ -1,12 +1,15 @@
-#version 330 core
+// lights shared by all lighting shaders and their lighting equations
 
-struct Material {
-    vec3 ambient;
-    vec3 diffuse;
-    vec3 specular;
-    float shininess;
-};
+// has to match MAX_POINT_LIGHTS in uniformbuffer.h
+#define MAX_POINT_LIGHTS 4
+
+// number of point lights that are computed, at most MAX_POINT_LIGHTS
+#ifndef NR_POINT_LIGHTS
+#define NR_POINT_LIGHTS 1
+#endif
 
+// the members are ordered so that the floats fill up the vec3s in the std140 layout,
+// see uniformbuffer.h for the matching C++ structs
 struct DirectionalLight {
     vec3 direction;
 
@@ -17,132 +20,119 @@ struct DirectionalLight {
 
 struct SpotLight {
     vec3 position;
-    vec3 direction;
     float cutOff;
+    vec3 direction;
     float outerCutOff;
-    
-    vec3 ambient;
-    vec3 diffuse;
-    vec3 specular;
 
+    vec3 ambient;
     float constant;
+    vec3 diffuse;
     float linear;
+    vec3 specular;
     float quadratic;
-
-    float enabled;
 };
 
 struct PointLight {
     vec3 position;
-    
-    vec3 ambient;
-    vec3 diffuse;
-    vec3 specular;
-
     float constant;
+
+    vec3 ambient;
     float linear;
+    vec3 diffuse;
     float quadratic;
+    vec3 specular;
 };
 
+layout (std140) uniform Lights {
+    DirectionalLight directionalLight;
+    PointLight pointLights[MAX_POINT_LIGHTS];
+    SpotLight spotLight;
+};
 
-in vec3 Normal;
-in vec3 FragPos;
-
-out vec4 FragColor;
-
-uniform Material material;
-uniform DirectionalLight directionalLight;
-uniform SpotLight spotLight;
-#define NR_POINT_LIGHTS 1
-uniform PointLight pointLights[NR_POINT_LIGHTS];
-
-vec3 calculateDirectionalLight(DirectionalLight light, vec3 normal, vec3 viewingDirection);
-vec3 calculatePointLight(PointLight light, vec3 normal, vec3 viewingDirection);
-vec3 calculateSpotLight(SpotLight light, vec3 normal, vec3 viewingDirection);
-
-void main() {
-    vec3 normalizedNormal = normalize(Normal);
-    vec3 viewingDirection = normalize(-FragPos); // camera position in view space is the origin
-
-    vec3 result = calculateDirectionalLight(directionalLight, normalizedNormal, viewingDirection);
-
-    for (int i = 0; i < NR_POINT_LIGHTS; ++i) {
-        result += calculatePointLight(pointLights[i], normalizedNormal, viewingDirection);
-    }
-
-    result += calculateSpotLight(spotLight, normalizedNormal, viewingDirection);
+// colors of the lit surface, from textures or from the material
+struct Surface {
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+    float shininess;
+};
 
-    FragColor = vec4(result, 1.0f);
-}
+// positions and directions are in view space
 
-vec3 calculateDirectionalLight(DirectionalLight light, vec3 normal, vec3 viewingDirection) {
+vec3 calculateDirectionalLight(DirectionalLight light, Surface surface, vec3 normal, vec3 viewingDirection) {
     // ambient lighting
-    vec3 ambient = light.ambient * material.ambient;
-    
+    vec3 ambient = light.ambient * surface.ambient;
+
     // diffuse lighting
     vec3 lightDirection = normalize(-light.direction);
-    vec3 diffuse = light.diffuse * (max(dot(normal, lightDirection), 0.0f) * material.diffuse);
+    vec3 diffuse = light.diffuse * (max(dot(normal, lightDirection), 0.0f) * surface.diffuse);
 
     // specular lighting
     vec3 reflectionDirection = reflect(-lightDirection, normal);
-    float spec = pow(max(dot(viewingDirection, reflectionDirection), 0.0), material.shininess);
-    vec3 specular = light.specular * (spec * material.specular);
+    float spec = pow(max(dot(viewingDirection, reflectionDirection), 0.0), surface.shininess);
+    vec3 specular = light.specular * (spec * surface.specular);
 
     return ambient + diffuse + specular;
 }
 
-vec3 calculateSpotLight(SpotLight light, vec3 normal, vec3 viewingDirection) {
+// without FLASHLIGHT only the ambient part of the spot light is computed
+vec3 calculateSpotLight(SpotLight light, Surface surface, vec3 normal, vec3 viewingDirection, vec3 position) {
     // ambient lighting
-    vec3 ambient = light.ambient * material.ambient;
-    
-    // diffuse lighting
-    vec3 lightDirection = normalize(light.position - FragPos);
-    vec3 diffuse = light.diffuse * (max(dot(normal, lightDirection), 0.0f) * material.diffuse);
-
-    // specular lighting
-    vec3 reflectionDirection = reflect(-lightDirection, normal);
-    float spec = pow(max(dot(viewingDirection, reflectionDirection), 0.0), material.shininess);
-    vec3 specular = light.specular * (spec * material.specular);
+    vec3 ambient = light.ambient * surface.ambient;
 
     // attenuation
-    float distance = length(light.position - FragPos);
+    float distance = length(light.position - position);
     float attenuation = 1.0f / (light.constant + light.linear * distance
                                                + light.quadratic * (distance * distance));
     ambient *= attenuation;
+
+#ifdef FLASHLIGHT
+    // diffuse lighting
+    vec3 lightDirection = normalize(light.position - position);
+    vec3 diffuse = light.diffuse * (max(dot(normal, lightDirection), 0.0f) * surface.diffuse);
+
+    // specular lighting
+    vec3 reflectionDirection = reflect(-lightDirection, normal);
+    float spec = pow(max(dot(viewingDirection, reflectionDirection), 0.0), surface.shininess);
+    vec3 specular = light.specular * (spec * surface.specular);
+
     diffuse *= attenuation;
     specular *= attenuation;
 
     // spotlight
     float theta = dot(lightDirection, normalize(-light.direction));
     float epsilon = light.cutOff - light.outerCutOff;
-    float intensity = clamp((theta - light.outerCutOff) / epsilon, 0.0, 1.0); 
+    float intensity = clamp((theta - light.outerCutOff) / epsilon, 0.0, 1.0);
 
-    diffuse *= intensity * light.enabled;
-    specular *= intensity * light.enabled;
+    diffuse *= intensity;
+    specular *= intensity;
 
     return ambient + diffuse + specular;
+#else
+    return ambient;
+#endif
 }
 
-vec3 calculatePointLight(PointLight light, vec3 normal, vec3 viewingDirection) {
+vec3 calculatePointLight(PointLight light, Surface surface, vec3 normal, vec3 viewingDirection, vec3 position) {
     // ambient lighting
-    vec3 ambient = light.ambient * material.ambient;
-    
+    vec3 ambient = light.ambient * surface.ambient;
+
     // diffuse lighting
-    vec3 lightDirection = normalize(light.position - FragPos);
-    vec3 diffuse = light.diffuse * (max(dot(normal, lightDirection), 0.0f) * material.diffuse);
+    vec3 lightDirection = normalize(light.position - position);
+    vec3 diffuse = light.diffuse * (max(dot(normal, lightDirection), 0.0f) * surface.diffuse);
 
     // specular lighting
     vec3 reflectionDirection = reflect(-lightDirection, normal);
-    float spec = pow(max(dot(viewingDirection, reflectionDirection), 0.0), material.shininess);
-    vec3 specular = light.specular * (spec * material.specular);
+    float spec = pow(max(dot(viewingDirection, reflectionDirection), 0.0), surface.shininess);
+    vec3 specular = light.specular * (spec * surface.specular);
 
     // attenuation
-    float distance = length(light.position - FragPos);
+    float distance = length(light.position - position);
     float attenuation = 1.0f / (light.constant + light.linear * distance
                                                + light.quadratic * (distance * distance));
     ambient *= attenuation;
     diffuse *= attenuation;
     specular *= attenuation;
-    
+
     return ambient + diffuse + specular;
 }
@@ -0,0 +1,10 @@
+// model-view and normal matrix of the drawn object, both computed on the CPU,
+// instanced draws (INSTANCED) read them per instance from the instance buffer,
+// see Instance in mesh.h
+#ifdef INSTANCED
+layout (location = 3) in mat4 modelView;
+layout (location = 7) in mat3 normalMatrix;
+#else
+uniform mat4 modelView;
+uniform mat3 normalMatrix;
+#endif
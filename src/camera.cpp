@@ -120,6 +120,10 @@ glm::vec3 Camera::getPosition() const {
     return position;
 }
 
+glm::vec3 Camera::getFront() const {
+    return front;
+}
+
 void Camera::setSprinting(bool sprinting) {
     this->sprinting = sprinting;
 }
@@ -183,3 +187,20 @@ void Camera::adjustDistance(float offset) {
     }
 }
 
+bool Camera::isThirdPerson() const {
+    return player && following && !firstPerson;
+}
+
+glm::vec3 Camera::getThirdPersonPivot() const {
+    return player->getPosition() + 2.0f * up;
+}
+
+void Camera::limitDistanceToPivot(float maximumDistance) {
+    glm::vec3 pivot = getThirdPersonPivot();
+    glm::vec3 offset = position - pivot;
+
+    if (glm::length(offset) > maximumDistance) {
+        position = pivot + maximumDistance * glm::normalize(offset);
+        front = glm::normalize(player->getPosition() - position);
+    }
+}
@@ -60,6 +60,7 @@ public:
     // getters and setters
     float getFOV() const;
     glm::vec3 getPosition() const;
+    glm::vec3 getFront() const;
     void setSprinting(bool running);
     glm::vec3 getPlayerPOVPosition() const;
     glm::vec3 getPlayerPOVFront() const;
@@ -70,6 +71,12 @@ public:
     bool isFollowing();
     void setFollowing(bool following);
     void adjustDistance(float offset);
+
+    // 3rd person camera: point above the player that the camera orbits
+    bool isThirdPerson() const;
+    glm::vec3 getThirdPersonPivot() const;
+    // move a 3rd person camera closer to the pivot, e.g., if the terrain is in between
+    void limitDistanceToPivot(float maximumDistance);
 };
 
 #endif
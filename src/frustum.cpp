@@ -0,0 +1,171 @@
+#include "frustum.h"
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+void transformBox(const glm::mat4 &matrix, const glm::vec3 &minimum, const glm::vec3 &maximum,
+                  glm::vec3 &newMinimum, glm::vec3 &newMaximum) {
+    // the center moves with the matrix, the extent along each axis is the sum of
+    // the absolute projections of the box axes
+    glm::vec3 center = glm::vec3(matrix * glm::vec4((minimum + maximum) * 0.5f, 1.0f));
+    glm::vec3 extent = (maximum - minimum) * 0.5f;
+
+    glm::vec3 newExtent(0.0f);
+    for (int column = 0; column < 3; ++column) {
+        newExtent += glm::abs(glm::vec3(matrix[column])) * extent[column];
+    }
+
+    newMinimum = center - newExtent;
+    newMaximum = center + newExtent;
+}
+
+void BoundingBoxes::resize(unsigned int size) {
+    minimumX.resize(size);
+    minimumY.resize(size);
+    minimumZ.resize(size);
+    maximumX.resize(size);
+    maximumY.resize(size);
+    maximumZ.resize(size);
+}
+
+unsigned int BoundingBoxes::size() const {
+    return minimumX.size();
+}
+
+void BoundingBoxes::set(unsigned int i, const glm::vec3 &minimum, const glm::vec3 &maximum) {
+    minimumX[i] = minimum.x;
+    minimumY[i] = minimum.y;
+    minimumZ[i] = minimum.z;
+    maximumX[i] = maximum.x;
+    maximumY[i] = maximum.y;
+    maximumZ[i] = maximum.z;
+}
+
+void BoundingBoxes::setTransformed(unsigned int i, const glm::mat4 &matrix,
+                                   const glm::vec3 &minimum, const glm::vec3 &maximum) {
+    glm::vec3 newMinimum;
+    glm::vec3 newMaximum;
+    transformBox(matrix, minimum, maximum, newMinimum, newMaximum);
+    set(i, newMinimum, newMaximum);
+}
+
+Frustum::Frustum(const glm::mat4 &projectionView) {
+    // planes from the rows of the matrix (Gribb/Hartmann):
+    // left, right, bottom, top, near, far
+    const glm::mat4 &m = projectionView;
+    for (int plane = 0; plane < NUMBER_OF_PLANES; ++plane) {
+        int row = plane / 2;
+        float sign = (plane % 2 == 0) ? 1.0f : -1.0f;
+
+        a[plane] = m[0][3] + sign * m[0][row];
+        b[plane] = m[1][3] + sign * m[1][row];
+        c[plane] = m[2][3] + sign * m[2][row];
+        d[plane] = m[3][3] + sign * m[3][row];
+    }
+}
+
+bool Frustum::isBoxVisible(const glm::vec3 &minimum, const glm::vec3 &maximum) const {
+    for (int plane = 0; plane < NUMBER_OF_PLANES; ++plane) {
+        // the corner farthest along the normal of the plane
+        float x = (a[plane] >= 0.0f) ? maximum.x : minimum.x;
+        float y = (b[plane] >= 0.0f) ? maximum.y : minimum.y;
+        float z = (c[plane] >= 0.0f) ? maximum.z : minimum.z;
+
+        // summed like the SIMD lanes below
+        if ((a[plane] * x + b[plane] * y) + (c[plane] * z + d[plane]) < 0.0f) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool Frustum::isBoxInside(const glm::vec3 &minimum, const glm::vec3 &maximum) const {
+    for (int plane = 0; plane < NUMBER_OF_PLANES; ++plane) {
+        // the corner nearest along the normal of the plane
+        float x = (a[plane] >= 0.0f) ? minimum.x : maximum.x;
+        float y = (b[plane] >= 0.0f) ? minimum.y : maximum.y;
+        float z = (c[plane] >= 0.0f) ? minimum.z : maximum.z;
+
+        if ((a[plane] * x + b[plane] * y) + (c[plane] * z + d[plane]) < 0.0f) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void Frustum::testBoxes(const BoundingBoxes &boxes, std::vector<unsigned char> &visible) const {
+    int count = boxes.size();
+    visible.resize(count);
+
+    // the farthest corner along the normal of a plane is the same for all boxes
+    const float *xs[NUMBER_OF_PLANES];
+    const float *ys[NUMBER_OF_PLANES];
+    const float *zs[NUMBER_OF_PLANES];
+    for (int plane = 0; plane < NUMBER_OF_PLANES; ++plane) {
+        xs[plane] = (a[plane] >= 0.0f) ? boxes.maximumX.data() : boxes.minimumX.data();
+        ys[plane] = (b[plane] >= 0.0f) ? boxes.maximumY.data() : boxes.minimumY.data();
+        zs[plane] = (c[plane] >= 0.0f) ? boxes.maximumZ.data() : boxes.minimumZ.data();
+    }
+
+    int i = 0;
+
+#ifdef __AVX2__
+    {
+        __m256 zero = _mm256_setzero_ps();
+
+        for (; i + 8 <= count; i += 8) {
+            __m256 outside = zero;
+            for (int plane = 0; plane < NUMBER_OF_PLANES; ++plane) {
+                __m256 distance = _mm256_add_ps(
+                    _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(a[plane]), _mm256_loadu_ps(xs[plane] + i)),
+                                  _mm256_mul_ps(_mm256_set1_ps(b[plane]), _mm256_loadu_ps(ys[plane] + i))),
+                    _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(c[plane]), _mm256_loadu_ps(zs[plane] + i)),
+                                  _mm256_set1_ps(d[plane])));
+                outside = _mm256_or_ps(outside, _mm256_cmp_ps(distance, zero, _CMP_LT_OQ));
+            }
+
+            int mask = _mm256_movemask_ps(outside);
+            for (int k = 0; k < 8; ++k) {
+                visible[i + k] = !((mask >> k) & 1);
+            }
+        }
+    }
+#endif
+
+#ifdef __SSE2__
+    {
+        __m128 zero = _mm_setzero_ps();
+
+        for (; i + 4 <= count; i += 4) {
+            __m128 outside = zero;
+            for (int plane = 0; plane < NUMBER_OF_PLANES; ++plane) {
+                __m128 distance = _mm_add_ps(
+                    _mm_add_ps(_mm_mul_ps(_mm_set1_ps(a[plane]), _mm_loadu_ps(xs[plane] + i)),
+                               _mm_mul_ps(_mm_set1_ps(b[plane]), _mm_loadu_ps(ys[plane] + i))),
+                    _mm_add_ps(_mm_mul_ps(_mm_set1_ps(c[plane]), _mm_loadu_ps(zs[plane] + i)),
+                               _mm_set1_ps(d[plane])));
+                outside = _mm_or_ps(outside, _mm_cmplt_ps(distance, zero));
+            }
+
+            int mask = _mm_movemask_ps(outside);
+            for (int k = 0; k < 4; ++k) {
+                visible[i + k] = !((mask >> k) & 1);
+            }
+        }
+    }
+#endif
+
+    for (; i < count; ++i) {
+        bool outside = false;
+        for (int plane = 0; plane < NUMBER_OF_PLANES; ++plane) {
+            if ((a[plane] * xs[plane][i] + b[plane] * ys[plane][i])
+                + (c[plane] * zs[plane][i] + d[plane]) < 0.0f) {
+                outside = true;
+            }
+        }
+        visible[i] = !outside;
+    }
+}
@@ -0,0 +1,52 @@
+#ifndef FRUSTUM_H
+#define FRUSTUM_H
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+// the axis-aligned box around the given box after the transformation
+void transformBox(const glm::mat4 &matrix, const glm::vec3 &minimum, const glm::vec3 &maximum,
+                  glm::vec3 &newMinimum, glm::vec3 &newMaximum);
+
+// axis-aligned boxes as structure of arrays, so that several of them fit into SIMD registers
+struct BoundingBoxes {
+    std::vector<float> minimumX;
+    std::vector<float> minimumY;
+    std::vector<float> minimumZ;
+    std::vector<float> maximumX;
+    std::vector<float> maximumY;
+    std::vector<float> maximumZ;
+
+    void resize(unsigned int size);
+    unsigned int size() const;
+    void set(unsigned int i, const glm::vec3 &minimum, const glm::vec3 &maximum);
+    // the box around the given box after the transformation
+    void setTransformed(unsigned int i, const glm::mat4 &matrix,
+                        const glm::vec3 &minimum, const glm::vec3 &maximum);
+};
+
+// view frustum for culling, extracted from a projection * view matrix
+class Frustum {
+private:
+    static const int NUMBER_OF_PLANES = 6;
+
+    // a * x + b * y + c * z + d >= 0 inside of each plane
+    float a[NUMBER_OF_PLANES];
+    float b[NUMBER_OF_PLANES];
+    float c[NUMBER_OF_PLANES];
+    float d[NUMBER_OF_PLANES];
+
+public:
+    Frustum(const glm::mat4 &projectionView);
+
+    // false only if the box is completely outside of one plane, boxes that are outside
+    // of the frustum but cross the planes near its corners count as visible
+    bool isBoxVisible(const glm::vec3 &minimum, const glm::vec3 &maximum) const;
+    // true if the whole box is inside of all planes
+    bool isBoxInside(const glm::vec3 &minimum, const glm::vec3 &maximum) const;
+    // visible[i] for all boxes, eight (AVX2, make SIMD=avx2) or four (SSE2) boxes at a time
+    void testBoxes(const BoundingBoxes &boxes, std::vector<unsigned char> &visible) const;
+};
+
+#endif
@@ -1,24 +1,86 @@
 #include "game.h"
 
+#include <algorithm>
+
 #include "gl.h"
 
-Game::Game()
-    : lightsourceShader("shaders/light.vs", "shaders/lightsource.fs"),
-      lightShader("shaders/materialLighting.vs", "shaders/materialLighting.fs"),
-      lightingShader("shaders/lighting.vs", "shaders/lighting.fs"),
-      transparencyShader("shaders/lighting.vs", "shaders/transparency.fs"),
+// minimum distance between the 3rd person camera and the terrain behind it
+static const float CAMERA_CLEARANCE = 0.5f;
+
+// craters dug with blastCrater()
+static const float CRATER_RANGE = 150.0f;
+static const float CRATER_RADIUS = 4.0f;
+static const float CRATER_DEPTH = 2.0f;
+
+// objects selected with selectObject()
+static const float SELECT_RANGE = 150.0f;
+
+// the lighting shaders only compute the point light that circles the mountains
+static const std::string POINT_LIGHTS_DEFINE = "NR_POINT_LIGHTS 1";
+
+Game::Game(const GameSettings &settings)
+    : noise(settings.seed),
+      heightMap(nullptr),
+      numberOfVisibleObjects(0),
+      numberOfOccludedObjects(0),
+      viewportWidth(1280),
+      viewportHeight(720),
+      lightsourceShader("shaders/light.vs", "shaders/lightsource.fs"),
+      lightShader("shaders/materialLighting.vs", "shaders/lighting.fs", {POINT_LIGHTS_DEFINE}),
+      lightingShader("shaders/lighting.vs", "shaders/lighting.fs", {"MATERIAL_TEXTURE", POINT_LIGHTS_DEFINE}),
+      transparencyShader("shaders/lighting.vs", "shaders/lighting.fs", {"MATERIAL_TEXTURE", "ALPHA_TEST", POINT_LIGHTS_DEFINE}),
       borderShader("shaders/materialLighting.vs", "shaders/border.fs"),
+      cameraBuffer(CAMERA_BLOCK_BINDING, sizeof(CameraBlock)),
+      lightsBuffer(LIGHTS_BLOCK_BINDING, sizeof(LightsBlock)),
       whiteLight(1.0f, 1.0f, 1.0f),
       redLight(1.0f, 0.0f, 0.0f) {
     this->flashlight = false;
 
-    // generate height map and create model from it
-    heightMap.generateMap();
-    Model* mapModel = new Model(heightMap.generateMesh());
+    // all shaders read camera and lights from the shared uniform buffers
+    for (Shader *shader : {&lightsourceShader, &lightShader, &lightingShader, &transparencyShader, &borderShader}) {
+        shader->bindUniformBlock("Camera", CAMERA_BLOCK_BINDING, sizeof(CameraBlock));
+        shader->bindUniformBlock("Lights", LIGHTS_BLOCK_BINDING, sizeof(LightsBlock));
+    }
+
+    // uniforms that never change
+    lightsourceShader.use();
+    lightsourceShader.setVec3v("lightSourceColor", redLight);
+
+    lightShader.use();
+    lightShader.setVec3("material.ambient", 0.0f, 1.0f, 0.6f);
+    lightShader.setVec3("material.diffuse", 0.0f, 1.0f, 1.0);
+    lightShader.setVec3("material.specular", 0.5, 0.5, 0.5);
+    lightShader.setFloat("material.shininess", 32.0f);
 
-    mapObject = new GameObject(mapModel);
-    mapObject->setShader(&lightingShader);
-    mapObject->setGravity(false);
+    lightingShader.use();
+    lightingShader.setFloat("material.shininess", 32.0f);
+
+    transparencyShader.use();
+    transparencyShader.setFloat("material.shininess", 32.0f);
+
+    if (!settings.mapPath.empty() && mapFile.open(settings.mapPath)) {
+        // chunks are read from the file around the camera, nothing is generated
+        terrain = new Terrain([this](int originX, int originY, int width, int depth, float *heights) {
+            mapFile.read(originX, originY, width, depth, heights);
+        });
+        terrain->setBounds(mapFile.getWidth(), mapFile.getDepth());
+
+    } else if (settings.terrainSize == GameSettings::INFINITE_TERRAIN) {
+        // chunks are generated around the camera while it moves
+        terrain = new Terrain([this](int originX, int originY, int width, int depth, float *heights) {
+            noise.generate(originX, originY, width, depth, heights);
+        });
+
+    } else {
+        // generate height map and create terrain chunks from it
+        heightMap = new HeightMap(std::max(settings.terrainSize, 2), std::max(settings.terrainSize, 2));
+        heightMap->generateMap(noise);
+        terrain = new Terrain(*heightMap);
+
+        if (!settings.saveMapPath.empty()) {
+            HeightMapFile::save(settings.saveMapPath, *heightMap);
+        }
+    }
 
     // Load backpack model and use it as player object
     Model *backpack = new Model;
@@ -105,21 +167,87 @@ Game::Game()
     addGameObject(grass);
 }
 
+Game::~Game() {
+    delete terrain;
+    delete heightMap;
+}
+
+const Terrain& Game::getTerrain() const {
+    return *terrain;
+}
+
+const RenderQueue& Game::getRenderQueue() const {
+    return renderQueue;
+}
+
+unsigned int Game::getNumberOfObjects() const {
+    return gameObjects.size();
+}
+
+unsigned int Game::getNumberOfVisibleObjects() const {
+    return numberOfVisibleObjects;
+}
+
+unsigned int Game::getNumberOfOccludedObjects() const {
+    return numberOfOccludedObjects;
+}
+
+void Game::setViewportSize(int width, int height) {
+    if (width > 0 && height > 0) {
+        viewportWidth = width;
+        viewportHeight = height;
+    }
+}
+
 void Game::addGameObject(GameObject *object) {
+    object->addToGame(this, gameObjects.size());
     gameObjects.push_back(object);
+
+    glm::vec3 minimum;
+    glm::vec3 maximum;
+    object->getBounds(minimum, maximum);
+    objectTree.insert(object->getID(), minimum, maximum);
 }
 
-void Game::simulateGravity(float deltaTime) {
-    for (GameObject *object : gameObjects) {
-        glm::vec3 position = object->getPosition();
+void Game::objectMoved(GameObject *object) {
+    movedObjects.push_back(object);
+}
 
-        object->simulateGravity(deltaTime, heightMap.getHeight(position.x, position.z));
+void Game::updateObjectTree() {
+    for (GameObject *object : movedObjects) {
+        glm::vec3 minimum;
+        glm::vec3 maximum;
+        object->getBounds(minimum, maximum);
+        objectTree.update(object->getID(), minimum, maximum);
+        object->clearMoved();
     }
+    movedObjects.clear();
 }
 
-void Game::draw(Shader &shader) {
-    for (GameObject *object : gameObjects) {
-        object->draw(shader);
+GameObject* Game::pickObject(const glm::vec3 &origin, const glm::vec3 &direction, float range) {
+    updateObjectTree();
+
+    float distance = range;
+    int id = objectTree.raycast(origin, glm::normalize(direction), distance);
+    return (id >= 0) ? gameObjects[id] : nullptr;
+}
+
+void Game::simulateGravity(float deltaTime) {
+    gravityXs.resize(gameObjects.size());
+    gravityZs.resize(gameObjects.size());
+    terrainHeights.resize(gameObjects.size());
+
+    for (unsigned int i = 0; i < gameObjects.size(); ++i) {
+        glm::vec3 position = gameObjects[i]->getPosition();
+        gravityXs[i] = position.x;
+        gravityZs[i] = position.z;
+    }
+
+    // one query for all objects instead of one per object
+    terrain->getHeights(gravityXs.data(), gravityZs.data(), terrainHeights.data(), gameObjects.size());
+
+    for (unsigned int i = 0; i < gameObjects.size(); ++i) {
+        gameObjects[i]->simulateGravity(deltaTime, terrainHeights[i]);
     }
 }
 
@@ -127,24 +255,66 @@ void Game::draw() {
     glStencilOp(GL_KEEP, GL_KEEP, GL_REPLACE); // Replace if both depth and stencil tests pass
     glStencilFunc(GL_ALWAYS, 1, 0xFF); // Stencil test always passes
     glStencilMask(0x00); // Disable writing to stencil buffer
-    if (mapObject) {
-        mapObject->draw();
-    }
 
-    glStencilMask(0xFF); // Enable writing to stencil buffer
+    // nothing outside of the view frustum is drawn
+    Frustum frustum(projectionMatrix * viewMatrix);
+    // nor what is hidden behind the terrain
+    occlusionBuffer.clear(projectionMatrix * viewMatrix);
 
-    for (GameObject *object : gameObjects) {
-        object->draw();
-    }
+    if (terrain) {
+        terrain->update(camera.getPosition());
+        terrain->selectLevelsOfDetail(camera.getPosition(), glm::radians(camera.getFOV()), (float)viewportHeight);
+        terrain->cull(frustum);
 
-    glStencilFunc(GL_NOTEQUAL, 1, 0xFF); // Stencil test passes outside of drawn objects
-    glStencilMask(0x00); // Disable writing to stencil buffer
-    glDisable(GL_DEPTH_TEST); // Make sure that floor (for example) does not overwrite borders
+        // the occluders lie below the terrain, so they are only behind it when seen from above
+        glm::vec3 position = camera.getPosition();
+        if (position.y > terrain->getHeight(position.x, position.z)) {
+            terrain->drawOccluders(occlusionBuffer);
+            occlusionBuffer.buildPyramid();
+        }
+
+        terrain->draw(lightingShader, occlusionBuffer);
+    }
 
-    for (GameObject *object : gameObjects) {
-        object->drawBorderObject();
+    updateObjectTree();
+    objectTree.queryFrustum(frustum, objectIDs);
+    // in the order the objects were added, so that every run draws the same
+    std::sort(objectIDs.begin(), objectIDs.end());
+
+    // objects that share model and shader are drawn together, sorted by state
+    numberOfVisibleObjects = 0;
+    numberOfOccludedObjects = 0;
+    for (unsigned int id : objectIDs) {
+        glm::vec3 minimum;
+        glm::vec3 maximum;
+        objectTree.getBounds(id, minimum, maximum);
+        if (occlusionBuffer.isBoxOccluded(minimum, maximum)) {
+            ++numberOfOccludedObjects;
+            continue;
+        }
+        ++numberOfVisibleObjects;
+
+        GameObject *object = gameObjects[id];
+        if (object->getShader()) {
+            renderQueue.add(OBJECT_PASS, object->getModel(), object->getShader(), object->getModelMatrix());
+        }
+        if (object->getBorderShader() && object->getDrawBorder()) {
+            renderQueue.add(BORDER_PASS, object->getModel(), object->getBorderShader(),
+                            object->getBorderModelMatrix());
+        }
     }
 
+    renderQueue.submit([](unsigned int pass) {
+        if (pass == OBJECT_PASS) {
+            glStencilMask(0xFF); // Enable writing to stencil buffer
+        } else if (pass == BORDER_PASS) {
+            glStencilFunc(GL_NOTEQUAL, 1, 0xFF); // Stencil test passes outside of drawn objects
+            glStencilMask(0x00); // Disable writing to stencil buffer
+            glDisable(GL_DEPTH_TEST); // Make sure that floor (for example) does not overwrite borders
+        }
+    });
+
+    glStencilMask(0x00); // Disable writing to stencil buffer
     glStencilFunc(GL_ALWAYS, 1, 0xFF); // Stencil test always passes
     glEnable(GL_DEPTH_TEST); // Re-enable depth test
 }
@@ -172,16 +342,46 @@ void Game::processGameLogic(float time) {
     lightSourceObject->setPosition(lightPosition);
 }
 
+void Game::blastCrater() {
+    TerrainHit hit = terrain->raycast(camera.getPosition(), camera.getFront(), CRATER_RANGE);
+    if (hit.hit) {
+        terrain->lower(hit.position.x, hit.position.z, CRATER_RADIUS, CRATER_DEPTH);
+    }
+}
+
+void Game::selectObject() {
+    // objects behind the terrain cannot be selected
+    TerrainHit hit = terrain->raycast(camera.getPosition(), camera.getFront(), SELECT_RANGE);
+    float range = hit.hit ? hit.distance : SELECT_RANGE;
+
+    GameObject *object = pickObject(camera.getPosition(), camera.getFront(), range);
+    if (object) {
+        object->setDrawBorder(!object->getDrawBorder());
+    }
+}
+
 void Game::setUpShaders() {
     //**********************************************************************
     // matrices
     //**********************************************************************
 
     // projection matrix
-    projectionMatrix = glm::perspective(glm::radians(camera.getFOV()), 1280.0f / 720.0f, 0.1f, 300.0f);
+    projectionMatrix = glm::perspective(glm::radians(camera.getFOV()),
+                                        (float)viewportWidth / (float)viewportHeight, 0.1f, 300.0f);
 
     // view matrix
     camera.update();
+
+    // keep the terrain from getting between the 3rd person camera and the player
+    if (camera.isThirdPerson()) {
+        glm::vec3 pivot = camera.getThirdPersonPivot();
+        glm::vec3 offset = camera.getPosition() - pivot;
+
+        TerrainHit hit = terrain->raycast(pivot, offset, glm::length(offset) + CAMERA_CLEARANCE);
+        if (hit.hit) {
+            camera.limitDistanceToPivot(std::max(hit.distance - CAMERA_CLEARANCE, 0.0f));
+        }
+    }
     viewMatrix = camera.getViewMatrix();
 
 
@@ -202,77 +402,27 @@ void Game::setUpShaders() {
     vsPlayerFront = glm::vec3(normalMatrix * camera.getPlayerPOVFront());
 
     //**********************************************************************
-    // light source shader
+    // shared uniform buffers
     //**********************************************************************
 
-    lightsourceShader.use();
-    lightsourceShader.setVec3v("lightSourceColor", redLight);
-    lightsourceShader.setMat4("view", viewMatrix);
-    lightsourceShader.setMat4("projection", projectionMatrix);
-
-    //**********************************************************************
-    // lighting shader (material)
-    //**********************************************************************
-
-    lightShader.use();
-    setUpLightingShader(lightShader);
-
-    // set material properties
-    lightShader.setVec3("material.ambient", 0.0f, 1.0f, 0.6f);
-    lightShader.setVec3("material.diffuse", 0.0f, 1.0f, 1.0);
-    lightShader.setVec3("material.specular", 0.5, 0.5, 0.5);
-    lightShader.setFloat("material.shininess", 32.0f);
-
-    // set transformations
-    lightShader.setMat4("view", viewMatrix);
-    lightShader.setMat4("projection", projectionMatrix);
-
-    glCheckError();
-
-    //**********************************************************************
-    // lighting shader
-    //**********************************************************************
-    lightingShader.use();
-    setUpLightingShader(lightingShader);
-
-    // set material properties
-    lightingShader.setVec3("material.specular", 0.5, 0.5, 0.5);
-    lightingShader.setFloat("material.shininess", 32.0f);
-
-    // set transformations
-    lightingShader.setMat4("view", camera.getViewMatrix());
-    lightingShader.setMat4("projection", projectionMatrix);
-
-    glCheckError();
-
-    //**********************************************************************
-    // transparency shader
-    //**********************************************************************
-    transparencyShader.use();
-    setUpLightingShader(transparencyShader);
-
-    // set material properties
-    transparencyShader.setVec3("material.specular", 0.5, 0.5, 0.5);
-    transparencyShader.setFloat("material.shininess", 32.0f);
-
-    // set transformations
-    transparencyShader.setMat4("view", camera.getViewMatrix());
-    transparencyShader.setMat4("projection", projectionMatrix);
+    // the flashlight is compiled into the lighting shaders, only its variants compute it
+    for (Shader *shader : {&lightShader, &lightingShader, &transparencyShader}) {
+        shader->setDefine("FLASHLIGHT", flashlight);
+    }
 
-    glCheckError();
+    Shader::setViewMatrix(viewMatrix);
 
-    //**********************************************************************
-    // border shader
-    //**********************************************************************
+    CameraBlock cameraBlock;
+    cameraBlock.view = viewMatrix;
+    cameraBlock.projection = projectionMatrix;
+    cameraBuffer.update(&cameraBlock);
 
-    borderShader.use();
-    borderShader.setMat4("view", camera.getViewMatrix());
-    borderShader.setMat4("projection", projectionMatrix);
+    updateLights();
 
     glCheckError();
 }
 
-void Game::setUpLightingShader(Shader &shader) {
+void Game::updateLights() {
     // light source
     glm::vec3 ambientWhite = whiteLight * glm::vec3(0.1f); 
     glm::vec3 diffuseWhite = whiteLight * glm::vec3(0.8f); 
@@ -286,43 +436,34 @@ void Game::setUpLightingShader(Shader &shader) {
     float attenuationLinear = 0.014f;
     float attenuationQuadratic = 0.0007f;
 
-    glCheckError();
+    LightsBlock lights = {};
 
     // directional light
-    shader.setVec3v("directionalLight.direction", vsLightDirection);
-    shader.setVec3v("directionalLight.ambient", 0.1f * ambientWhite);
-    shader.setVec3v("directionalLight.diffuse", 0.1f * diffuseWhite);
-    shader.setVec3v("directionalLight.specular", 0.1f * specularWhite);
-
-    glCheckError();
+    lights.directionalLight.direction = vsLightDirection;
+    lights.directionalLight.ambient = 0.1f * ambientWhite;
+    lights.directionalLight.diffuse = 0.1f * diffuseWhite;
+    lights.directionalLight.specular = 0.1f * specularWhite;
 
     // point light
-    shader.setVec3v("pointLights[0].position", vsLightPosition);
-    shader.setVec3v("pointLights[0].ambient", ambientRed);
-    shader.setVec3v("pointLights[0].diffuse", diffuseRed);
-    shader.setVec3v("pointLights[0].specular", specularRed);
-    shader.setFloat("pointLights[0].constant", attenuationConstant);
-    shader.setFloat("pointLights[0].linear", attenuationLinear);
-    shader.setFloat("pointLights[0].quadratic", attenuationQuadratic);	
-
-    glCheckError();
+    lights.pointLights[0].position = vsLightPosition;
+    lights.pointLights[0].ambient = ambientRed;
+    lights.pointLights[0].diffuse = diffuseRed;
+    lights.pointLights[0].specular = specularRed;
+    lights.pointLights[0].constant = attenuationConstant;
+    lights.pointLights[0].linear = attenuationLinear;
+    lights.pointLights[0].quadratic = attenuationQuadratic;
 
     // flashlight
-    shader.setVec3v("spotLight.position", vsPlayerPosition);
-    shader.setVec3v("spotLight.direction", vsPlayerFront);
-    shader.setFloat("spotLight.cutOff", glm::cos(glm::radians(12.5f)));
-    shader.setFloat("spotLight.outerCutOff", glm::cos(glm::radians(17.5f)));
-    if (flashlight) {
-        shader.setFloat("spotLight.enabled", 1.0f);
-    } else {
-        shader.setFloat("spotLight.enabled", 0.0f);
-    }
-    shader.setVec3v("spotLight.ambient", ambientWhite);
-    shader.setVec3v("spotLight.diffuse", diffuseWhite);
-    shader.setVec3v("spotLight.specular", specularWhite);
-    shader.setFloat("spotLight.constant", attenuationConstant);
-    shader.setFloat("spotLight.linear", attenuationLinear);
-    shader.setFloat("spotLight.quadratic", attenuationQuadratic);	
-
-    glCheckError();
+    lights.spotLight.position = vsPlayerPosition;
+    lights.spotLight.direction = vsPlayerFront;
+    lights.spotLight.cutOff = glm::cos(glm::radians(12.5f));
+    lights.spotLight.outerCutOff = glm::cos(glm::radians(17.5f));
+    lights.spotLight.ambient = ambientWhite;
+    lights.spotLight.diffuse = diffuseWhite;
+    lights.spotLight.specular = specularWhite;
+    lights.spotLight.constant = attenuationConstant;
+    lights.spotLight.linear = attenuationLinear;
+    lights.spotLight.quadratic = attenuationQuadratic;
+
+    lightsBuffer.update(&lights);
 }
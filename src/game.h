@@ -1,19 +1,73 @@
 #ifndef GAME_H
 #define GAME_H
 
+#include <string>
 #include <vector>
 
 #include "camera.h"
+#include "frustum.h"
 
 #include "gameobject.h"
 #include "heightmap.h"
+#include "heightmapfile.h"
+#include "occlusion.h"
+#include "octree.h"
+#include "renderqueue.h"
 #include "shader.h"
+#include "terrain.h"
+#include "terrainnoise.h"
+#include "uniformbuffer.h"
+
+// options chosen on the command line
+struct GameSettings {
+    static const int DEFAULT_TERRAIN_SIZE = 200;
+    // larger maps would overflow the indices of the height and normal buffers
+    static const int MAXIMUM_TERRAIN_SIZE = 16384;
+    // terrain size for an unbounded terrain that is generated around the camera
+    static const int INFINITE_TERRAIN = 0;
+
+    int terrainSize = DEFAULT_TERRAIN_SIZE;
+    uint32_t seed = TerrainNoise::DEFAULT_SEED;
+
+    // height map file to stream the terrain from instead of generating it
+    std::string mapPath;
+    // file to save the generated height map to
+    std::string saveMapPath;
+};
 
 class Game {
 private:
     std::vector<GameObject*> gameObjects;
-    HeightMap heightMap;
-    GameObject *mapObject;
+    TerrainNoise noise;
+    // only for a generated finite terrain, streamed terrains have none
+    HeightMap *heightMap;
+    HeightMapFile mapFile;
+
+    // positions and terrain heights of all objects for the batched gravity queries
+    std::vector<float> gravityXs;
+    std::vector<float> gravityZs;
+    std::vector<float> terrainHeights;
+    Terrain *terrain;
+
+    // passes of the render queue
+    static const unsigned int OBJECT_PASS = 0;
+    static const unsigned int BORDER_PASS = 1;
+    RenderQueue renderQueue;
+
+    // world space bounds of the objects for culling and picking, indexed by the position
+    // of the object in gameObjects; only the objects that have moved are updated
+    Octree objectTree;
+    std::vector<GameObject*> movedObjects;
+    std::vector<unsigned int> objectIDs;
+    unsigned int numberOfVisibleObjects;
+
+    // depth of the terrain for skipping what is hidden behind it, drawn every frame
+    OcclusionBuffer occlusionBuffer;
+    unsigned int numberOfOccludedObjects;
+
+    // size of the framebuffer in pixels, for the aspect ratio and the level of detail
+    int viewportWidth;
+    int viewportHeight;
 
 public:
     Camera camera;
@@ -24,6 +78,9 @@ public:
     Shader lightingShader;
     Shader transparencyShader;
     Shader borderShader;
+    // camera and light state shared by all shaders, written once per frame
+    UniformBuffer cameraBuffer;
+    UniformBuffer lightsBuffer;
     std::vector<GameObject*> rotatingCrates;
     GameObject *lightSourceObject;
 
@@ -46,16 +103,36 @@ public:
     std::vector<GameObject*> vegetation;
 
 private:
-    void setUpLightingShader(Shader &shader);
+    void updateLights();
+    void updateObjectTree();
 
 public:
-    Game();
+    Game(const GameSettings &settings = GameSettings());
+    // the terrain goes first, its workers read the noise and the map file
+    ~Game();
+
+    Game(const Game&) = delete;
+    Game& operator=(const Game&) = delete;
 
+    const Terrain& getTerrain() const;
+    const RenderQueue& getRenderQueue() const;
+    unsigned int getNumberOfObjects() const;
+    unsigned int getNumberOfVisibleObjects() const;
+    unsigned int getNumberOfOccludedObjects() const;
+    // the framebuffer has been resized, empty sizes (minimized windows) are ignored
+    void setViewportSize(int width, int height);
     void addGameObject(GameObject *object);
+    // called by objects whose bounds have changed
+    void objectMoved(GameObject *object);
+    // nearest object whose box the ray hits within the range, nullptr if there is none
+    GameObject* pickObject(const glm::vec3 &origin, const glm::vec3 &direction, float range);
     void simulateGravity(float deltaTime);
-    void draw(Shader &shader);
     void draw();
     void processGameLogic(float time);
+    // dig a crater where the camera looks at the terrain
+    void blastCrater();
+    // toggle the border of the object the camera looks at
+    void selectObject();
     void setUpShaders();
 };
 
@@ -1,5 +1,6 @@
 #include "gameobject.h"
 
+#include "frustum.h"
 #include "game.h"
 
 void GameObject::updateFront() {
@@ -29,6 +30,17 @@ GameObject::GameObject(Model *model) {
     shader = nullptr;
     borderShader = nullptr;
     drawBorder = false;
+
+    game = nullptr;
+    id = 0;
+    moved = false;
+}
+
+void GameObject::markMoved() {
+    if (game && !moved) {
+        moved = true;
+        game->objectMoved(this);
+    }
 }
 
 glm::vec3 GameObject::getPosition() const {
@@ -53,14 +65,17 @@ float GameObject::getPitch() const {
 
 void GameObject::setPosition(const glm::vec3 &position) {
     this->position = position;
+    markMoved();
 }
 
 void GameObject::setHeightOffset(const float offset) {
     heightOffset = offset;
+    markMoved();
 }
 
 void GameObject::setYawOffset(const float offset) {
     yawOffset = offset;
+    markMoved();
 }
 
 void GameObject::setGravity(bool gravity) {
@@ -69,6 +84,7 @@ void GameObject::setGravity(bool gravity) {
 
 void GameObject::setScale(float scale) {
     this->scale = scale;
+    markMoved();
 }
 
 void GameObject::processDirectionChange(float yawOffset, float pitchOffset) {
@@ -76,6 +92,7 @@ void GameObject::processDirectionChange(float yawOffset, float pitchOffset) {
     pitch += pitchOffset;
 
     updateFront();
+    markMoved();
 }
 
 void GameObject::setDirection(float yaw, float pitch) {
@@ -83,10 +100,12 @@ void GameObject::setDirection(float yaw, float pitch) {
     this->pitch = pitch;
 
     updateFront();
+    markMoved();
 }
 
 void GameObject::move(glm::vec3 direction) {
     position += direction;
+    markMoved();
 }
 
 void GameObject::jump() {
@@ -109,42 +128,54 @@ void GameObject::simulateGravity(float deltaTime, float mapHeight) {
             position.y -= displacement;
 
             velocity = newVelocity;
+            markMoved();
         }
 
         if (position.y < mapHeight) {
             falling = false;
             velocity = 0.0f;
             position.y = mapHeight;
+            markMoved();
         }
     }
 }
 
 
-void GameObject::draw(Shader &shader) {
+Model* GameObject::getModel() {
+    return model;
+}
+
+glm::mat4 GameObject::getModelMatrix() const {
     glm::mat4 model = glm::mat4(1.0f);
     model = glm::translate(model, position);
     model = glm::translate(model, glm::vec3(0.0f, heightOffset, 0.0f));
     model = glm::rotate(model, glm::radians(yaw + yawOffset), glm::vec3(0.0f, -1.0f, 0.0f));
     model = glm::rotate(model, glm::radians(pitch), glm::vec3(0.0f, 0.0f, 1.0f));
     model = glm::scale(model, glm::vec3(scale));
-    shader.setMat4("model", model);
+    return model;
+}
 
-    this->model->draw(shader);
+glm::mat4 GameObject::getBorderModelMatrix() const {
+    return glm::scale(getModelMatrix(), glm::vec3(1.1f));
 }
 
-void GameObject::drawBorderObject(Shader &shader) {
-    if (drawBorder) {
-        glm::mat4 model = glm::mat4(1.0f);
-        model = glm::translate(model, position);
-        model = glm::translate(model, glm::vec3(0.0f, heightOffset, 0.0f));
-        model = glm::rotate(model, glm::radians(yaw + yawOffset), glm::vec3(0.0f, -1.0f, 0.0f));
-        model = glm::rotate(model, glm::radians(pitch), glm::vec3(0.0f, 0.0f, 1.0f));
-        model = glm::scale(model, glm::vec3(scale));
-        model = glm::scale(model, glm::vec3(1.1f));
-        shader.setMat4("model", model);
+void GameObject::getBounds(glm::vec3 &minimum, glm::vec3 &maximum) {
+    // the border is a bit larger than the object
+    glm::mat4 matrix = drawBorder ? getBorderModelMatrix() : getModelMatrix();
+    transformBox(matrix, model->getBoundsMinimum(), model->getBoundsMaximum(), minimum, maximum);
+}
 
-        this->model->draw(shader);
-    }
+void GameObject::addToGame(Game *game, unsigned int id) {
+    this->game = game;
+    this->id = id;
+}
+
+unsigned int GameObject::getID() const {
+    return id;
+}
+
+void GameObject::clearMoved() {
+    moved = false;
 }
 
 void GameObject::setShader(Shader *shader) {
@@ -165,18 +196,9 @@ Shader* GameObject::getBorderShader() {
 
 void GameObject::setDrawBorder(bool drawBorder) {
     this->drawBorder = drawBorder;
+    markMoved();
 }
 
-void GameObject::draw() {
-    if (shader) {
-        shader->use();
-        draw(*shader);
-    }
-}
-
-void GameObject::drawBorderObject() {
-    if (borderShader) {
-        borderShader->use();
-        drawBorderObject(*borderShader);
-    }
+bool GameObject::getDrawBorder() const {
+    return drawBorder;
 }
@@ -41,8 +41,16 @@ private:
     float heightOffset;
     float yawOffset;
 
+    // game that keeps the object in its spatial index, and the index of the object there
+    Game *game;
+    unsigned int id;
+    // already reported to the game as moved since its last update
+    bool moved;
+
     // compute new front vector from yaw and pitch
     void updateFront();
+    // tell the game that the bounds have changed
+    void markMoved();
 
 public:
     GameObject(Model *model);
@@ -72,17 +80,24 @@ public:
     // compute new position after deltaTime
     void simulateGravity(float deltaTime, float mapHeight);
 
-    // draw model of this object
-    void draw(Shader &shader);
-    void drawBorderObject(Shader &shader);
+    Model* getModel();
+    // placement of the model, and of its border that is a bit larger
+    glm::mat4 getModelMatrix() const;
+    glm::mat4 getBorderModelMatrix() const;
+    // world space box around the model, and around the border if it is drawn
+    void getBounds(glm::vec3 &minimum, glm::vec3 &maximum);
+
+    void addToGame(Game *game, unsigned int id);
+    unsigned int getID() const;
+    // the game has updated the bounds of the moved object
+    void clearMoved();
 
     void setShader(Shader *shader);
     void setBorderShader(Shader *shader);
     void setDrawBorder(bool drawBorder);
+    bool getDrawBorder() const;
     Shader* getShader();
     Shader* getBorderShader();
-    void draw();
-    void drawBorderObject();
 };
 
 #endif
@@ -1,6 +1,72 @@
 #include "gl.h"
 
 #include <iostream>
+#include <string>
+
+#if GL_ERROR_CHECKING >= 1
+static const char* getDebugSourceName(GLenum source) {
+    switch (source) {
+        case GL_DEBUG_SOURCE_API:             return "API";
+        case GL_DEBUG_SOURCE_WINDOW_SYSTEM:   return "WINDOW_SYSTEM";
+        case GL_DEBUG_SOURCE_SHADER_COMPILER: return "SHADER_COMPILER";
+        case GL_DEBUG_SOURCE_THIRD_PARTY:     return "THIRD_PARTY";
+        case GL_DEBUG_SOURCE_APPLICATION:     return "APPLICATION";
+        default:                              return "OTHER";
+    }
+}
+
+static const char* getDebugTypeName(GLenum type) {
+    switch (type) {
+        case GL_DEBUG_TYPE_ERROR:               return "ERROR";
+        case GL_DEBUG_TYPE_DEPRECATED_BEHAVIOR: return "DEPRECATED_BEHAVIOR";
+        case GL_DEBUG_TYPE_UNDEFINED_BEHAVIOR:  return "UNDEFINED_BEHAVIOR";
+        case GL_DEBUG_TYPE_PORTABILITY:         return "PORTABILITY";
+        case GL_DEBUG_TYPE_PERFORMANCE:         return "PERFORMANCE";
+        case GL_DEBUG_TYPE_MARKER:              return "MARKER";
+        default:                                return "OTHER";
+    }
+}
+
+static const char* getDebugSeverityName(GLenum severity) {
+    switch (severity) {
+        case GL_DEBUG_SEVERITY_HIGH:   return "HIGH";
+        case GL_DEBUG_SEVERITY_MEDIUM: return "MEDIUM";
+        case GL_DEBUG_SEVERITY_LOW:    return "LOW";
+        default:                       return "NOTIFICATION";
+    }
+}
+
+// the message is null-terminated, so its length is not needed
+static void APIENTRY printDebugMessage(GLenum source, GLenum type, GLuint id, GLenum severity,
+                                       GLsizei /* length */, const GLchar *message,
+                                       const void * /* userParam */) {
+    std::ostream &stream = (type == GL_DEBUG_TYPE_ERROR) ? std::cerr : std::cout;
+    stream << ((type == GL_DEBUG_TYPE_ERROR) ? "ERROR::GL::" : "INFO::GL::") << getDebugTypeName(type)
+           << " " << getDebugSourceName(source) << " " << getDebugSeverityName(severity)
+           << " (" << id << ") " << message << std::endl;
+}
+#endif
+
+void setUpDebugOutput() {
+#if GL_ERROR_CHECKING >= 1
+    if (!GLAD_GL_KHR_debug) {
+        std::cout << "INFO::GL No KHR_debug, errors are only found with glGetError" << std::endl;
+        return;
+    }
+
+    glEnable(GL_DEBUG_OUTPUT);
+#if GL_ERROR_CHECKING >= 2
+    // the callback runs within the GL call that caused the message
+    glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
+#endif
+    glDebugMessageCallback(printDebugMessage, nullptr);
+    // no notifications, and the low severity hints only when debugging
+    glDebugMessageControl(GL_DONT_CARE, GL_DONT_CARE, GL_DEBUG_SEVERITY_NOTIFICATION, 0, nullptr, GL_FALSE);
+#if GL_ERROR_CHECKING < 2
+    glDebugMessageControl(GL_DONT_CARE, GL_DONT_CARE, GL_DEBUG_SEVERITY_LOW, 0, nullptr, GL_FALSE);
+#endif
+#endif
+}
 
 GLenum glCheckError_(const char *file, int line) {
     GLenum errorCode;
@@ -3,8 +3,30 @@
 
 #include <glad/glad.h>
 
+// how GL errors are found, set at compile time (make GL_ERROR_CHECKING=N):
+// 0 not at all, no glGetError and no debug output
+// 1 KHR_debug messages and one glGetError per frame (glCheckFrameError)
+// 2 additionally glGetError at every glCheckError() and synchronous KHR_debug messages,
+//   so that an error is reported at (and in a debugger stops in) the call that caused it
+#ifndef GL_ERROR_CHECKING
+#define GL_ERROR_CHECKING 1
+#endif
+
+// print the messages of the driver if it has KHR_debug, after gladLoadGL
+void setUpDebugOutput();
+
 GLenum glCheckError_(const char *file, int line);
 
-#define glCheckError() glCheckError_(__FILE__, __LINE__) 
+#if GL_ERROR_CHECKING >= 2
+#define glCheckError() glCheckError_(__FILE__, __LINE__)
+#else
+#define glCheckError() ((void)0)
+#endif
+
+#if GL_ERROR_CHECKING >= 1
+#define glCheckFrameError() glCheckError_(__FILE__, __LINE__)
+#else
+#define glCheckFrameError() ((void)0)
+#endif
 
 #endif
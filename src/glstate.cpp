@@ -0,0 +1,266 @@
+#include "glstate.h"
+
+#include <vector>
+
+// state that has to be set on the next call, whatever the value
+static const GLuint UNKNOWN = 0xffffffff;
+
+// the entry points of the driver
+static PFNGLUSEPROGRAMPROC driverUseProgram;
+static PFNGLDELETEPROGRAMPROC driverDeleteProgram;
+static PFNGLBINDVERTEXARRAYPROC driverBindVertexArray;
+static PFNGLDELETEVERTEXARRAYSPROC driverDeleteVertexArrays;
+static PFNGLACTIVETEXTUREPROC driverActiveTexture;
+static PFNGLBINDTEXTUREPROC driverBindTexture;
+static PFNGLDELETETEXTURESPROC driverDeleteTextures;
+static PFNGLENABLEPROC driverEnable;
+static PFNGLDISABLEPROC driverDisable;
+static PFNGLBLENDFUNCPROC driverBlendFunc;
+static PFNGLDEPTHFUNCPROC driverDepthFunc;
+static PFNGLDEPTHMASKPROC driverDepthMask;
+static PFNGLSTENCILFUNCPROC driverStencilFunc;
+static PFNGLSTENCILMASKPROC driverStencilMask;
+static PFNGLSTENCILOPPROC driverStencilOp;
+
+// shadowed state
+static GLuint program;
+static GLuint vertexArray;
+static GLuint activeTexture;
+// GL_TEXTURE_2D binding per texture unit, other targets are not tracked
+static std::vector<GLuint> textures2D;
+static GLuint blend;
+static GLuint depthTest;
+static GLuint stencilTest;
+static GLenum blendFunc[2];
+static GLenum depthFunc;
+static GLuint depthMask;
+static GLuint stencilFunc[3];
+static GLuint stencilMask;
+static GLenum stencilOp[3];
+
+static unsigned long long issuedCalls = 0;
+static unsigned long long skippedCalls = 0;
+
+// true if the call has to reach the driver, and then remembers the new value
+template<typename T>
+static bool changes(T &current, T value) {
+    if (current == value) {
+        ++skippedCalls;
+        return false;
+    }
+    current = value;
+    ++issuedCalls;
+    return true;
+}
+
+static void APIENTRY useProgram(GLuint newProgram) {
+    if (changes(program, newProgram)) {
+        driverUseProgram(newProgram);
+    }
+}
+
+static void APIENTRY deleteProgram(GLuint deletedProgram) {
+    // a deleted program stays in use until another one is, but its name may be reused
+    if (program == deletedProgram) {
+        program = UNKNOWN;
+    }
+    driverDeleteProgram(deletedProgram);
+}
+
+static void APIENTRY bindVertexArray(GLuint newVertexArray) {
+    if (changes(vertexArray, newVertexArray)) {
+        driverBindVertexArray(newVertexArray);
+    }
+}
+
+static void APIENTRY deleteVertexArrays(GLsizei n, const GLuint *arrays) {
+    // deleting the bound VAO binds 0
+    for (GLsizei i = 0; i < n; ++i) {
+        if (vertexArray == arrays[i]) {
+            vertexArray = 0;
+        }
+    }
+    driverDeleteVertexArrays(n, arrays);
+}
+
+static void APIENTRY setActiveTexture(GLenum texture) {
+    if (changes(activeTexture, (GLuint)texture)) {
+        driverActiveTexture(texture);
+    }
+}
+
+static void APIENTRY bindTexture(GLenum target, GLuint texture) {
+    unsigned int unit = activeTexture - GL_TEXTURE0;
+    if (target != GL_TEXTURE_2D || unit >= textures2D.size()) {
+        ++issuedCalls;
+        driverBindTexture(target, texture);
+        return;
+    }
+
+    if (changes(textures2D[unit], texture)) {
+        driverBindTexture(target, texture);
+    }
+}
+
+static void APIENTRY deleteTextures(GLsizei n, const GLuint *deletedTextures) {
+    // deleted textures are unbound from all units
+    for (GLsizei i = 0; i < n; ++i) {
+        for (GLuint &texture : textures2D) {
+            if (texture == deletedTextures[i]) {
+                texture = 0;
+            }
+        }
+    }
+    driverDeleteTextures(n, deletedTextures);
+}
+
+static GLuint* getCapability(GLenum capability) {
+    switch (capability) {
+    case GL_BLEND:
+        return &blend;
+    case GL_DEPTH_TEST:
+        return &depthTest;
+    case GL_STENCIL_TEST:
+        return &stencilTest;
+    default:
+        return nullptr;
+    }
+}
+
+static void APIENTRY enable(GLenum capability) {
+    GLuint *enabled = getCapability(capability);
+    if (!enabled) {
+        ++issuedCalls;
+        driverEnable(capability);
+    } else if (changes(*enabled, (GLuint)GL_TRUE)) {
+        driverEnable(capability);
+    }
+}
+
+static void APIENTRY disable(GLenum capability) {
+    GLuint *enabled = getCapability(capability);
+    if (!enabled) {
+        ++issuedCalls;
+        driverDisable(capability);
+    } else if (changes(*enabled, (GLuint)GL_FALSE)) {
+        driverDisable(capability);
+    }
+}
+
+static void APIENTRY setBlendFunc(GLenum sfactor, GLenum dfactor) {
+    if (blendFunc[0] == sfactor && blendFunc[1] == dfactor) {
+        ++skippedCalls;
+        return;
+    }
+    blendFunc[0] = sfactor;
+    blendFunc[1] = dfactor;
+    ++issuedCalls;
+    driverBlendFunc(sfactor, dfactor);
+}
+
+static void APIENTRY setDepthFunc(GLenum func) {
+    if (changes(depthFunc, func)) {
+        driverDepthFunc(func);
+    }
+}
+
+static void APIENTRY setDepthMask(GLboolean flag) {
+    if (changes(depthMask, (GLuint)flag)) {
+        driverDepthMask(flag);
+    }
+}
+
+static void APIENTRY setStencilFunc(GLenum func, GLint ref, GLuint mask) {
+    if (stencilFunc[0] == func && stencilFunc[1] == (GLuint)ref && stencilFunc[2] == mask) {
+        ++skippedCalls;
+        return;
+    }
+    stencilFunc[0] = func;
+    stencilFunc[1] = ref;
+    stencilFunc[2] = mask;
+    ++issuedCalls;
+    driverStencilFunc(func, ref, mask);
+}
+
+static void APIENTRY setStencilMask(GLuint mask) {
+    if (changes(stencilMask, mask)) {
+        driverStencilMask(mask);
+    }
+}
+
+static void APIENTRY setStencilOp(GLenum fail, GLenum zfail, GLenum zpass) {
+    if (stencilOp[0] == fail && stencilOp[1] == zfail && stencilOp[2] == zpass) {
+        ++skippedCalls;
+        return;
+    }
+    stencilOp[0] = fail;
+    stencilOp[1] = zfail;
+    stencilOp[2] = zpass;
+    ++issuedCalls;
+    driverStencilOp(fail, zfail, zpass);
+}
+
+void GLStateCache::install() {
+    // the state of the context is not known yet, so the first call of each function goes through
+    program = UNKNOWN;
+    vertexArray = UNKNOWN;
+    activeTexture = UNKNOWN;
+    blend = UNKNOWN;
+    depthTest = UNKNOWN;
+    stencilTest = UNKNOWN;
+    blendFunc[0] = blendFunc[1] = UNKNOWN;
+    depthFunc = UNKNOWN;
+    depthMask = UNKNOWN;
+    stencilFunc[0] = stencilFunc[1] = stencilFunc[2] = UNKNOWN;
+    stencilMask = UNKNOWN;
+    stencilOp[0] = stencilOp[1] = stencilOp[2] = UNKNOWN;
+
+    int numberOfUnits = 0;
+    glGetIntegerv(GL_MAX_COMBINED_TEXTURE_IMAGE_UNITS, &numberOfUnits);
+    textures2D.assign(numberOfUnits, UNKNOWN);
+
+    // installing twice would make the cache call itself
+    if (glad_glUseProgram == useProgram) {
+        return;
+    }
+
+    driverUseProgram = glad_glUseProgram;
+    driverDeleteProgram = glad_glDeleteProgram;
+    driverBindVertexArray = glad_glBindVertexArray;
+    driverDeleteVertexArrays = glad_glDeleteVertexArrays;
+    driverActiveTexture = glad_glActiveTexture;
+    driverBindTexture = glad_glBindTexture;
+    driverDeleteTextures = glad_glDeleteTextures;
+    driverEnable = glad_glEnable;
+    driverDisable = glad_glDisable;
+    driverBlendFunc = glad_glBlendFunc;
+    driverDepthFunc = glad_glDepthFunc;
+    driverDepthMask = glad_glDepthMask;
+    driverStencilFunc = glad_glStencilFunc;
+    driverStencilMask = glad_glStencilMask;
+    driverStencilOp = glad_glStencilOp;
+
+    glad_glUseProgram = useProgram;
+    glad_glDeleteProgram = deleteProgram;
+    glad_glBindVertexArray = bindVertexArray;
+    glad_glDeleteVertexArrays = deleteVertexArrays;
+    glad_glActiveTexture = setActiveTexture;
+    glad_glBindTexture = bindTexture;
+    glad_glDeleteTextures = deleteTextures;
+    glad_glEnable = enable;
+    glad_glDisable = disable;
+    glad_glBlendFunc = setBlendFunc;
+    glad_glDepthFunc = setDepthFunc;
+    glad_glDepthMask = setDepthMask;
+    glad_glStencilFunc = setStencilFunc;
+    glad_glStencilMask = setStencilMask;
+    glad_glStencilOp = setStencilOp;
+}
+
+unsigned long long GLStateCache::getNumberOfIssuedCalls() {
+    return issuedCalls;
+}
+
+unsigned long long GLStateCache::getNumberOfSkippedCalls() {
+    return skippedCalls;
+}
@@ -0,0 +1,20 @@
+#ifndef GLSTATE_H
+#define GLSTATE_H
+
+#include <glad/glad.h>
+
+// shadows the current program, VAO, 2D texture bindings, blending, depth and stencil state
+// and drops calls that would not change them; install() replaces the glad entry points
+// (glUseProgram, glBindTexture, glEnable, ...) so that every call in the code goes through
+// the cache without changing the call sites
+class GLStateCache {
+public:
+    // after gladLoadGL, once per context
+    static void install();
+
+    // calls of the tracked functions that reached the driver or were dropped
+    static unsigned long long getNumberOfIssuedCalls();
+    static unsigned long long getNumberOfSkippedCalls();
+};
+
+#endif
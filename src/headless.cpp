@@ -0,0 +1,160 @@
+#include "headless.h"
+
+#include <cstring>
+#include <iostream>
+
+#include <glad/glad.h>
+#include <EGL/eglext.h>
+
+#include "gl.h"
+
+HeadlessContext::HeadlessContext(int width, int height) {
+    this->width = width;
+    this->height = height;
+
+    display = EGL_NO_DISPLAY;
+    context = EGL_NO_CONTEXT;
+
+    framebuffer = 0;
+    colorBuffer = 0;
+    depthStencilBuffer = 0;
+}
+
+HeadlessContext::~HeadlessContext() {
+    destroy();
+}
+
+EGLDisplay HeadlessContext::getSurfacelessDisplay() {
+    // prefer Mesa's surfaceless platform, it does not need any display server or GPU
+    const char *extensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+
+    if (extensions && std::strstr(extensions, "EGL_MESA_platform_surfaceless")) {
+        PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay
+            = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+
+        if (getPlatformDisplay) {
+            EGLDisplay surfaceless = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+            if (surfaceless != EGL_NO_DISPLAY) {
+                return surfaceless;
+            }
+        }
+    }
+
+    return eglGetDisplay(EGL_DEFAULT_DISPLAY);
+}
+
+bool HeadlessContext::create() {
+    display = getSurfacelessDisplay();
+
+    EGLint major, minor;
+    if (display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor)) {
+        std::cerr << "ERROR::HEADLESS::EGL_INITIALIZATION_FAILED" << std::endl;
+        return false;
+    }
+    std::cout << "INFO::HEADLESS EGL " << major << "." << minor << std::endl;
+
+    if (!eglBindAPI(EGL_OPENGL_API)) {
+        std::cerr << "ERROR::HEADLESS::OPENGL_API_NOT_SUPPORTED" << std::endl;
+        return false;
+    }
+
+    const EGLint configAttributes[] = {
+        EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+        EGL_NONE
+    };
+
+    EGLConfig config;
+    EGLint numberOfConfigs;
+    if (!eglChooseConfig(display, configAttributes, &config, 1, &numberOfConfigs) || numberOfConfigs < 1) {
+        std::cerr << "ERROR::HEADLESS::NO_SUITABLE_CONFIG" << std::endl;
+        return false;
+    }
+
+    // same context version and profile as the windowed mode
+    const EGLint contextAttributes[] = {
+        EGL_CONTEXT_MAJOR_VERSION, 3,
+        EGL_CONTEXT_MINOR_VERSION, 3,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+#if GL_ERROR_CHECKING >= 2
+        EGL_CONTEXT_OPENGL_DEBUG, EGL_TRUE,
+#endif
+        EGL_NONE
+    };
+
+    context = eglCreateContext(display, config, EGL_NO_CONTEXT, contextAttributes);
+    if (context == EGL_NO_CONTEXT) {
+        std::cerr << "ERROR::HEADLESS::CONTEXT_CREATION_FAILED" << std::endl;
+        return false;
+    }
+
+    // no surface at all, we only ever render into our own framebuffer
+    if (!eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context)) {
+        std::cerr << "ERROR::HEADLESS::MAKE_CURRENT_FAILED" << std::endl;
+        return false;
+    }
+
+    if (!gladLoadGLLoader((GLADloadproc)eglGetProcAddress)) {
+        std::cerr << "Failed to initialize GLAD" << std::endl;
+        return false;
+    }
+
+    std::cout << "INFO::HEADLESS Renderer " << glGetString(GL_RENDERER) << std::endl;
+
+    return createFramebuffer();
+}
+
+bool HeadlessContext::createFramebuffer() {
+    glGenFramebuffers(1, &framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+
+    // color attachment
+    glGenRenderbuffers(1, &colorBuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, colorBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorBuffer);
+
+    // depth and stencil attachment (the game uses the stencil buffer for borders)
+    glGenRenderbuffers(1, &depthStencilBuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, depthStencilBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depthStencilBuffer);
+
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        std::cerr << "ERROR::HEADLESS::FRAMEBUFFER_INCOMPLETE" << std::endl;
+        return false;
+    }
+
+    glViewport(0, 0, width, height);
+
+    glCheckError();
+
+    return true;
+}
+
+void HeadlessContext::destroy() {
+    if (context != EGL_NO_CONTEXT) {
+        glDeleteRenderbuffers(1, &colorBuffer);
+        glDeleteRenderbuffers(1, &depthStencilBuffer);
+        glDeleteFramebuffers(1, &framebuffer);
+
+        eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        eglDestroyContext(display, context);
+        context = EGL_NO_CONTEXT;
+    }
+
+    if (display != EGL_NO_DISPLAY) {
+        eglTerminate(display);
+        display = EGL_NO_DISPLAY;
+    }
+}
+
+int HeadlessContext::getWidth() const {
+    return width;
+}
+
+int HeadlessContext::getHeight() const {
+    return height;
+}
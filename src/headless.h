@@ -0,0 +1,36 @@
+#ifndef HEADLESS_H
+#define HEADLESS_H
+
+#include <EGL/egl.h>
+
+// OpenGL context without window or display (EGL surfaceless, e.g., llvmpipe)
+// that renders into an offscreen framebuffer object
+class HeadlessContext {
+private:
+    EGLDisplay display;
+    EGLContext context;
+
+    // offscreen framebuffer and its attachments
+    unsigned int framebuffer;
+    unsigned int colorBuffer;
+    unsigned int depthStencilBuffer;
+
+    int width;
+    int height;
+
+    EGLDisplay getSurfacelessDisplay();
+    bool createFramebuffer();
+
+public:
+    HeadlessContext(int width, int height);
+    ~HeadlessContext();
+
+    // create context, make it current, load OpenGL functions, and bind the framebuffer
+    bool create();
+    void destroy();
+
+    int getWidth() const;
+    int getHeight() const;
+};
+
+#endif
@@ -1,211 +1,507 @@
 #include "heightmap.h"
 
+#include <algorithm>
+#include <cassert>
+#include <limits>
+
 #include <glm/gtx/string_cast.hpp>
 
-HeightMap::HeightMap() {
-    heightMap = new float*[SIZE];
-    for (int i = 0; i < SIZE; ++i) {
-        heightMap[i] = new float[SIZE];
-    }
+#ifdef __AVX2__
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+HeightMap::HeightMap(int width, int depth)
+    : width(width),
+      depth(depth),
+      heights(width * depth, 0.0f),
+      faceNormals(2 * (width - 1) * (depth - 1), glm::vec3(0.0f, 1.0f, 0.0f)) {
+    setUpPyramid();
+}
 
-    normals = new glm::vec3**[SIZE - 1];
+int HeightMap::getWidth() const {
+    return width;
+}
 
-    for (int i = 0; i < SIZE - 1; ++i) {
-        normals[i] = new glm::vec3*[SIZE - 1];
-        
-        for (int j = 0; j < SIZE - 1; ++j) {
-            normals[i][j] = new glm::vec3[2];
-        }
-    }
+int HeightMap::getDepth() const {
+    return depth;
 }
 
-HeightMap::~HeightMap() {
-    for (int i = 0; i < SIZE; ++i) {
-        delete[] heightMap[i];
-    }
-    delete[] heightMap;
+float& HeightMap::heightAt(int x, int y) {
+    assert(x >= 0 && x < width && y >= 0 && y < depth);
+    return heights[y * width + x];
+}
 
-    for (int i = 0; i < SIZE - 1; ++i) {
-        
-        for (int j = 0; j < SIZE - 1; ++j) {
-            delete[] normals[i][j];
-        }
-        delete[] normals[i];
-    }
-    delete[] normals;
+float HeightMap::heightAt(int x, int y) const {
+    assert(x >= 0 && x < width && y >= 0 && y < depth);
+    return heights[y * width + x];
 }
 
-void HeightMap::generateMap() {
-    heightMap[0][0] = 0.0f;
+float HeightMap::getHeightAt(int x, int y) const {
+    return heightAt(x, y);
+}
 
-    for (int x = 1; x < SIZE; ++x) {
-        int heightOffset = (rand() % 100) - 50;
-        float heightOffsetFloat = (float)heightOffset / 400.0f;
+void HeightMap::setHeightAt(int x, int y, float height) {
+    heightAt(x, y) = height;
+}
 
-        heightMap[x][0] = heightMap[x - 1][0] + heightOffsetFloat;
-    }
+glm::vec3& HeightMap::faceNormalAt(int x, int y, int triangle) {
+    assert(x >= 0 && x < width - 1 && y >= 0 && y < depth - 1 && (triangle == 0 || triangle == 1));
+    return faceNormals[2 * (y * (width - 1) + x) + triangle];
+}
 
-    for (int y = 1; y < SIZE; ++y) {
-        int heightOffset = (rand() % 100) - 50;
-        float heightOffsetFloat = (float)heightOffset / 400.0f;
+const glm::vec3& HeightMap::faceNormalAt(int x, int y, int triangle) const {
+    assert(x >= 0 && x < width - 1 && y >= 0 && y < depth - 1 && (triangle == 0 || triangle == 1));
+    return faceNormals[2 * (y * (width - 1) + x) + triangle];
+}
 
-        heightMap[0][y] = heightMap[0][y - 1] + heightOffsetFloat;
-    }
+void HeightMap::generateMap(const TerrainNoise &noise, int originX, int originY) {
+    noise.generate(originX, originY, width, depth, heights.data());
+    updatePyramid(0, 0, width - 1, depth - 1);
+}
 
-    for (int y = 1; y < SIZE; ++y) {
-        for (int x = 1; x < SIZE; ++x) {
-            float prevX = heightMap[x - 1][y];
-            float prevY = heightMap[x][y - 1];
-            float average = (prevX + prevY) / 2.0f;
+void HeightMap::fillMap(const HeightGenerator &generator, int originX, int originY) {
+    generator(originX, originY, width, depth, heights.data());
+    updatePyramid(0, 0, width - 1, depth - 1);
+}
 
-            int heightOffset = (rand() % 100) - 50;
-            float heightOffsetFloat = (float)heightOffset / 100.0f;
-            if (y < SIZE / 2 && x < SIZE / 2) {
-                heightOffsetFloat += 0.2f;
-            } else {
-                heightOffsetFloat -= 0.2f;
-            }
+glm::vec3 HeightMap::computeFaceNormal(int x, int y, int triangle) const {
+    // corners of the square
+    glm::vec3 ll = glm::vec3((float) x, heightAt(x, y), (float) y);
+    glm::vec3 lr = glm::vec3((float) (x + 1), heightAt(x + 1, y), (float) y);
+    glm::vec3 ul = glm::vec3((float) x, heightAt(x, y + 1), (float) (y + 1));
 
-            heightMap[x][y] = average + heightOffsetFloat;
-        }
+    if (triangle == 0) {
+        return glm::normalize(glm::cross(ul - ll, lr - ll));
     }
+
+    glm::vec3 ur = glm::vec3((float) (x + 1), heightAt(x + 1, y + 1), (float) (y + 1));
+
+    return glm::normalize(glm::cross(ur - ul, lr - ul));
 }
 
-glm::vec3 HeightMap::computeNormal(unsigned int x, unsigned int y) {
-    std::vector<glm::vec3> normalCandidates;
+glm::vec3 HeightMap::getNormal(int x, int y) const {
+    // average of the normals of all triangles sharing this vertex
+    glm::vec3 normal(0.0f, 0.0f, 0.0f);
+    int numberOfCandidates = 0;
 
-    if (x > 0 && y < SIZE - 1) {
-        normalCandidates.push_back(normals[x - 1][y][0]);
-        normalCandidates.push_back(normals[x - 1][y][1]);
+    if (x > 0 && y < depth - 1) {
+        normal += faceNormalAt(x - 1, y, 0);
+        normal += faceNormalAt(x - 1, y, 1);
+        numberOfCandidates += 2;
     }
 
-    if (y > 0 && x < SIZE - 1) {
-        normalCandidates.push_back(normals[x][y - 1][0]);
-        normalCandidates.push_back(normals[x][y - 1][1]);
+    if (y > 0 && x < width - 1) {
+        normal += faceNormalAt(x, y - 1, 0);
+        normal += faceNormalAt(x, y - 1, 1);
+        numberOfCandidates += 2;
     }
 
     if (x > 0 && y > 0) {
-        normalCandidates.push_back(normals[x - 1][y - 1][1]);
+        normal += faceNormalAt(x - 1, y - 1, 1);
+        numberOfCandidates += 1;
     }
 
-    if (x < SIZE - 1 && y < SIZE - 1) {
-        normalCandidates.push_back(normals[x][y][0]);
+    if (x < width - 1 && y < depth - 1) {
+        normal += faceNormalAt(x, y, 0);
+        numberOfCandidates += 1;
     }
 
-    glm::vec3 normal(0.0f, 0.0f, 0.0f);
-    for (const glm::vec3 &vec : normalCandidates) {
-        normal += vec;
+    return (1.0f / (float)numberOfCandidates) * normal;
+}
+
+float HeightMap::getHeight(float x, float y) const {
+    if (x < 0 || y < 0 || x > width - 1 || y > depth - 1) {
+        return -std::numeric_limits<float>::infinity();
     }
 
-    return (1.0f / (float)normalCandidates.size()) * normal;
+    // the last row and column interpolate within the square before them
+    int xInt = std::min((int)floor(x), width - 2);
+    int yInt = std::min((int)floor(y), depth - 2);
+
+    float ll = heightAt(xInt, yInt); 
+    float lr = heightAt(xInt + 1, yInt); 
+    float ul = heightAt(xInt, yInt + 1); 
+    float ur = heightAt(xInt + 1, yInt + 1); 
+
+    float s = x - (float)xInt;
+    float t = y - (float)yInt;
+
+    return (1 - t) * ((1 - s) * ll + s * lr) + t * ((1 - s) * ul + s * ur);
 }
 
-Mesh HeightMap::generateMesh() {
-    std::vector<Texture> textures;
-    Texture texture = Texture::createTextureFromFile("textures/moon2.jpg", "texture_diffuse");
-    textures.push_back(texture);
-    Texture texture_specular = Texture::createTextureFromFile("textures/moon2_specular.jpg", "texture_specular");
-    textures.push_back(texture_specular);
+void HeightMap::getHeights(const float *xs, const float *ys, float *results, int count) const {
+    int i = 0;
+
+    // the vector paths compute exactly the same as getHeight(), lane by lane
+#ifdef __AVX2__
+    {
+        __m256 zero = _mm256_setzero_ps();
+        __m256 one = _mm256_set1_ps(1.0f);
+        __m256 lastX = _mm256_set1_ps((float)(width - 1));
+        __m256 lastY = _mm256_set1_ps((float)(depth - 1));
+        __m256 lastSquareX = _mm256_set1_ps((float)(width - 2));
+        __m256 lastSquareY = _mm256_set1_ps((float)(depth - 2));
+        __m256 negativeInfinity = _mm256_set1_ps(-std::numeric_limits<float>::infinity());
+        __m256i rowLength = _mm256_set1_epi32(width);
+
+        for (; i + 8 <= count; i += 8) {
+            __m256 x = _mm256_loadu_ps(xs + i);
+            __m256 y = _mm256_loadu_ps(ys + i);
+
+            __m256 outside = _mm256_or_ps(_mm256_or_ps(_mm256_cmp_ps(x, zero, _CMP_LT_OQ), _mm256_cmp_ps(y, zero, _CMP_LT_OQ)),
+                                          _mm256_or_ps(_mm256_cmp_ps(x, lastX, _CMP_GT_OQ), _mm256_cmp_ps(y, lastY, _CMP_GT_OQ)));
+
+            // clamp first so that positions outside of the map still gather valid heights
+            __m256 lowerX = _mm256_min_ps(_mm256_floor_ps(_mm256_min_ps(_mm256_max_ps(x, zero), lastX)), lastSquareX);
+            __m256 lowerY = _mm256_min_ps(_mm256_floor_ps(_mm256_min_ps(_mm256_max_ps(y, zero), lastY)), lastSquareY);
+
+            __m256i index = _mm256_add_epi32(_mm256_mullo_epi32(_mm256_cvttps_epi32(lowerY), rowLength),
+                                             _mm256_cvttps_epi32(lowerX));
+            __m256 ll = _mm256_i32gather_ps(heights.data(), index, 4);
+            __m256 lr = _mm256_i32gather_ps(heights.data() + 1, index, 4);
+            __m256 ul = _mm256_i32gather_ps(heights.data() + width, index, 4);
+            __m256 ur = _mm256_i32gather_ps(heights.data() + width + 1, index, 4);
+
+            __m256 s = _mm256_sub_ps(x, lowerX);
+            __m256 t = _mm256_sub_ps(y, lowerY);
+            __m256 oneMinusS = _mm256_sub_ps(one, s);
+
+            __m256 lower = _mm256_add_ps(_mm256_mul_ps(oneMinusS, ll), _mm256_mul_ps(s, lr));
+            __m256 upper = _mm256_add_ps(_mm256_mul_ps(oneMinusS, ul), _mm256_mul_ps(s, ur));
+            __m256 height = _mm256_add_ps(_mm256_mul_ps(_mm256_sub_ps(one, t), lower), _mm256_mul_ps(t, upper));
+
+            _mm256_storeu_ps(results + i, _mm256_blendv_ps(height, negativeInfinity, outside));
+        }
+    }
+#endif
+
+#ifdef __SSE2__
+    {
+        __m128 zero = _mm_setzero_ps();
+        __m128 one = _mm_set1_ps(1.0f);
+        __m128 lastX = _mm_set1_ps((float)(width - 1));
+        __m128 lastY = _mm_set1_ps((float)(depth - 1));
+        __m128 lastSquareX = _mm_set1_ps((float)(width - 2));
+        __m128 lastSquareY = _mm_set1_ps((float)(depth - 2));
+        __m128 negativeInfinity = _mm_set1_ps(-std::numeric_limits<float>::infinity());
+
+        for (; i + 4 <= count; i += 4) {
+            __m128 x = _mm_loadu_ps(xs + i);
+            __m128 y = _mm_loadu_ps(ys + i);
+
+            __m128 outside = _mm_or_ps(_mm_or_ps(_mm_cmplt_ps(x, zero), _mm_cmplt_ps(y, zero)),
+                                       _mm_or_ps(_mm_cmpgt_ps(x, lastX), _mm_cmpgt_ps(y, lastY)));
+
+            // after clamping to the map, truncation is the same as floor
+            __m128i lowerXInt = _mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(x, zero), lastX));
+            __m128i lowerYInt = _mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(y, zero), lastY));
+            __m128 lowerX = _mm_min_ps(_mm_cvtepi32_ps(lowerXInt), lastSquareX);
+            __m128 lowerY = _mm_min_ps(_mm_cvtepi32_ps(lowerYInt), lastSquareY);
+
+            // SSE2 has no gather, so the corners are loaded one by one
+            int cornersX[4];
+            int cornersY[4];
+            _mm_storeu_si128((__m128i*)cornersX, _mm_cvttps_epi32(lowerX));
+            _mm_storeu_si128((__m128i*)cornersY, _mm_cvttps_epi32(lowerY));
+
+            const float *lane[4];
+            for (int k = 0; k < 4; ++k) {
+                lane[k] = &heights[cornersY[k] * width + cornersX[k]];
+            }
 
-    // generate normals
-    for (int x = 1; x < SIZE; ++x) {
-        for (int y = 1; y < SIZE; ++y) {
-            // current square
-            glm::vec3 ll = glm::vec3((float) (x - 1), heightMap[x - 1][y - 1], (float) (y - 1));
-            glm::vec3 lr = glm::vec3((float) x, heightMap[x][y - 1], (float) (y - 1));
-            glm::vec3 ul = glm::vec3((float) (x - 1), heightMap[x - 1][y], (float) y);
-            glm::vec3 ur = glm::vec3((float) x, heightMap[x][y], (float) y);
+            __m128 ll = _mm_setr_ps(lane[0][0], lane[1][0], lane[2][0], lane[3][0]);
+            __m128 lr = _mm_setr_ps(lane[0][1], lane[1][1], lane[2][1], lane[3][1]);
+            __m128 ul = _mm_setr_ps(lane[0][width], lane[1][width], lane[2][width], lane[3][width]);
+            __m128 ur = _mm_setr_ps(lane[0][width + 1], lane[1][width + 1], lane[2][width + 1], lane[3][width + 1]);
 
-            glm::vec3 firstNormal = glm::normalize(glm::cross(ul - ll, lr - ll));
-            glm::vec3 secondNormal = glm::normalize(glm::cross(ur - ul, lr - ul));
+            __m128 s = _mm_sub_ps(x, lowerX);
+            __m128 t = _mm_sub_ps(y, lowerY);
+            __m128 oneMinusS = _mm_sub_ps(one, s);
 
-            normals[x - 1][y - 1][0] = firstNormal;
-            normals[x - 1][y - 1][1] = secondNormal;
+            __m128 lower = _mm_add_ps(_mm_mul_ps(oneMinusS, ll), _mm_mul_ps(s, lr));
+            __m128 upper = _mm_add_ps(_mm_mul_ps(oneMinusS, ul), _mm_mul_ps(s, ur));
+            __m128 height = _mm_add_ps(_mm_mul_ps(_mm_sub_ps(one, t), lower), _mm_mul_ps(t, upper));
 
+            _mm_storeu_ps(results + i, _mm_or_ps(_mm_and_ps(outside, negativeInfinity),
+                                                 _mm_andnot_ps(outside, height)));
         }
     }
+#endif
 
-    std::vector<Vertex> vertices;
-    std::vector<unsigned int> indices;
-
-    for (int x = 1; x < SIZE; ++x) {
-        for (int y = 1; y < SIZE; ++y) {
-            // current square
-            glm::vec3 ll = glm::vec3((float) (x - 1), heightMap[x - 1][y - 1], (float) (y - 1));
-            glm::vec3 llNormal = computeNormal(x - 1, y - 1);
-
-            glm::vec3 lr = glm::vec3((float) x, heightMap[x][y - 1], (float) (y - 1));
-            glm::vec3 lrNormal = computeNormal(x, y - 1);
-
-            glm::vec3 ul = glm::vec3((float) (x - 1), heightMap[x - 1][y], (float) y);
-            glm::vec3 ulNormal = computeNormal(x - 1, y);
-
-            glm::vec3 ur = glm::vec3((float) x, heightMap[x][y], (float) y);
-            glm::vec3 urNormal = computeNormal(x, y);
-
-            // generate two triangles for the current square
-            Vertex vertex;
-
-            // first triangle
-            vertex.position = ll;
-            vertex.normal = llNormal;
-            vertex.textureCoordinates = glm::vec2(0.0f, 0.0f);
-            indices.push_back(vertices.size());
-            vertices.push_back(vertex);
-
-            vertex.position = ul;
-            vertex.normal = ulNormal;
-            vertex.textureCoordinates = glm::vec2(0.0f, 1.0f);
-            indices.push_back(vertices.size());
-            vertices.push_back(vertex);
-
-            vertex.position = lr;
-            vertex.normal = lrNormal;
-            vertex.textureCoordinates = glm::vec2(1.0f, 0.0f);
-            indices.push_back(vertices.size());
-            vertices.push_back(vertex);
-
-            // second triangle
-            vertex.position = ul;
-            vertex.normal = ulNormal;
-            vertex.textureCoordinates = glm::vec2(0.0f, 1.0f);
-            indices.push_back(vertices.size());
-            vertices.push_back(vertex);
-
-            vertex.position = lr;
-            vertex.normal = lrNormal;
-            vertex.textureCoordinates = glm::vec2(1.0f, 0.0f);
-            indices.push_back(vertices.size());
-            vertices.push_back(vertex);
-
-            vertex.position = ur;
-            vertex.normal = urNormal;
-            vertex.textureCoordinates = glm::vec2(1.0f, 1.0f);
-            indices.push_back(vertices.size());
-            vertices.push_back(vertex);
+    for (; i < count; ++i) {
+        results[i] = getHeight(xs[i], ys[i]);
+    }
+}
 
+void HeightMap::setUpPyramid() {
+    // all heights are still zero
+    int levelWidth = (width - 2) / PYRAMID_BLOCK_SIZE + 1;
+    int levelDepth = (depth - 2) / PYRAMID_BLOCK_SIZE + 1;
+
+    while (true) {
+        PyramidLevel level;
+        level.width = levelWidth;
+        level.depth = levelDepth;
+        level.minimum.assign(levelWidth * levelDepth, 0.0f);
+        level.maximum.assign(levelWidth * levelDepth, 0.0f);
+        pyramid.push_back(level);
+
+        if (levelWidth == 1 && levelDepth == 1) {
+            break;
         }
+        levelWidth = (levelWidth + 1) / 2;
+        levelDepth = (levelDepth + 1) / 2;
     }
+}
 
-    return Mesh(vertices, indices, textures);
+void HeightMap::getBlockBounds(int level, int x, int y, int &firstX, int &firstY, int &lastX, int &lastY) const {
+    int squares = PYRAMID_BLOCK_SIZE << level;
+
+    firstX = x * squares;
+    firstY = y * squares;
+    lastX = std::min(firstX + squares, width - 1);
+    lastY = std::min(firstY + squares, depth - 1);
 }
 
-float HeightMap::getHeight(float x, float y) const {
-    if (x < 0 || y < 0 || x > SIZE || y > SIZE) {
-        return -std::numeric_limits<float>::infinity();
+void HeightMap::updatePyramid(int firstX, int firstY, int lastX, int lastY) {
+    // squares touching the changed grid points, and the blocks containing them
+    int firstBlockX = std::max(firstX - 1, 0) / PYRAMID_BLOCK_SIZE;
+    int firstBlockY = std::max(firstY - 1, 0) / PYRAMID_BLOCK_SIZE;
+    int lastBlockX = std::min(lastX, width - 2) / PYRAMID_BLOCK_SIZE;
+    int lastBlockY = std::min(lastY, depth - 2) / PYRAMID_BLOCK_SIZE;
+
+    for (int y = std::max(firstY - 1, 0); y <= std::min(lastY, depth - 2); ++y) {
+        for (int x = std::max(firstX - 1, 0); x <= std::min(lastX, width - 2); ++x) {
+            faceNormalAt(x, y, 0) = computeFaceNormal(x, y, 0);
+            faceNormalAt(x, y, 1) = computeFaceNormal(x, y, 1);
+        }
     }
 
-    int xInt = (int)floor(x);
-    int yInt = (int)floor(y);
+    PyramidLevel &blocks = pyramid[0];
+    for (int blockY = firstBlockY; blockY <= lastBlockY; ++blockY) {
+        for (int blockX = firstBlockX; blockX <= lastBlockX; ++blockX) {
+            int blockFirstX, blockFirstY, blockLastX, blockLastY;
+            getBlockBounds(0, blockX, blockY, blockFirstX, blockFirstY, blockLastX, blockLastY);
+
+            float minimum = std::numeric_limits<float>::infinity();
+            float maximum = -std::numeric_limits<float>::infinity();
+            for (int y = blockFirstY; y <= blockLastY; ++y) {
+                for (int x = blockFirstX; x <= blockLastX; ++x) {
+                    minimum = std::min(minimum, heightAt(x, y));
+                    maximum = std::max(maximum, heightAt(x, y));
+                }
+            }
 
-    float ll = heightMap[xInt][yInt]; 
-    float lr = heightMap[xInt + 1][yInt]; 
-    float ul = heightMap[xInt][yInt + 1]; 
-    float ur = heightMap[xInt + 1][yInt + 1]; 
+            blocks.minimum[blockY * blocks.width + blockX] = minimum;
+            blocks.maximum[blockY * blocks.width + blockX] = maximum;
+        }
+    }
 
-    float s = x - (float)xInt;
-    float t = y - (float)yInt;
+    for (unsigned int level = 1; level < pyramid.size(); ++level) {
+        const PyramidLevel &below = pyramid[level - 1];
+        PyramidLevel &current = pyramid[level];
+
+        firstBlockX /= 2;
+        firstBlockY /= 2;
+        lastBlockX /= 2;
+        lastBlockY /= 2;
+
+        for (int blockY = firstBlockY; blockY <= lastBlockY; ++blockY) {
+            for (int blockX = firstBlockX; blockX <= lastBlockX; ++blockX) {
+                float minimum = std::numeric_limits<float>::infinity();
+                float maximum = -std::numeric_limits<float>::infinity();
+
+                for (int y = 2 * blockY; y <= std::min(2 * blockY + 1, below.depth - 1); ++y) {
+                    for (int x = 2 * blockX; x <= std::min(2 * blockX + 1, below.width - 1); ++x) {
+                        minimum = std::min(minimum, below.minimum[y * below.width + x]);
+                        maximum = std::max(maximum, below.maximum[y * below.width + x]);
+                    }
+                }
+
+                current.minimum[blockY * current.width + blockX] = minimum;
+                current.maximum[blockY * current.width + blockX] = maximum;
+            }
+        }
+    }
+}
 
-    return (1 - t) * ((1 - s) * ll + s * lr) + t * ((1 - s) * ul + s * ur);
-} 
+// distances at which the ray enters and leaves an axis-aligned box, false if it misses it
+static bool intersectBox(const glm::vec3 &origin, const glm::vec3 &direction,
+                         const glm::vec3 &minimum, const glm::vec3 &maximum,
+                         float &entry, float &exit) {
+    entry = 0.0f;
+    exit = std::numeric_limits<float>::infinity();
+
+    for (int axis = 0; axis < 3; ++axis) {
+        if (direction[axis] == 0.0f) {
+            // parallel to the slab, either always or never inside
+            if (origin[axis] < minimum[axis] || origin[axis] > maximum[axis]) {
+                return false;
+            }
+            continue;
+        }
+
+        float nearDistance = (minimum[axis] - origin[axis]) / direction[axis];
+        float farDistance = (maximum[axis] - origin[axis]) / direction[axis];
+        if (nearDistance > farDistance) {
+            std::swap(nearDistance, farDistance);
+        }
+
+        entry = std::max(entry, nearDistance);
+        exit = std::min(exit, farDistance);
+        if (entry > exit) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Moeller-Trumbore intersection of a ray with a triangle (from both sides)
+static bool intersectTriangle(const glm::vec3 &origin, const glm::vec3 &direction,
+                              const glm::vec3 &a, const glm::vec3 &b, const glm::vec3 &c,
+                              float &distance) {
+    glm::vec3 ab = b - a;
+    glm::vec3 ac = c - a;
+    glm::vec3 p = glm::cross(direction, ac);
+    float determinant = glm::dot(ab, p);
+    if (std::abs(determinant) < 1e-12f) {
+        return false;
+    }
+
+    float inverseDeterminant = 1.0f / determinant;
+    glm::vec3 ao = origin - a;
+    float u = glm::dot(ao, p) * inverseDeterminant;
+    if (u < 0.0f || u > 1.0f) {
+        return false;
+    }
+
+    glm::vec3 q = glm::cross(ao, ab);
+    float v = glm::dot(direction, q) * inverseDeterminant;
+    if (v < 0.0f || u + v > 1.0f) {
+        return false;
+    }
+
+    distance = glm::dot(ac, q) * inverseDeterminant;
+    return distance >= 0.0f;
+}
+
+bool HeightMap::intersectSquare(const glm::vec3 &origin, const glm::vec3 &direction, int x, int y,
+                                float &distance, glm::vec3 &normal) const {
+    // same triangles as the terrain mesh
+    glm::vec3 ll = glm::vec3((float) x, heightAt(x, y), (float) y);
+    glm::vec3 lr = glm::vec3((float) (x + 1), heightAt(x + 1, y), (float) y);
+    glm::vec3 ul = glm::vec3((float) x, heightAt(x, y + 1), (float) (y + 1));
+    glm::vec3 ur = glm::vec3((float) (x + 1), heightAt(x + 1, y + 1), (float) (y + 1));
+
+    bool hit = false;
+    float triangleDistance;
+
+    if (intersectTriangle(origin, direction, ll, ul, lr, triangleDistance) && triangleDistance < distance) {
+        distance = triangleDistance;
+        normal = faceNormalAt(x, y, 0);
+        hit = true;
+    }
+    if (intersectTriangle(origin, direction, ul, lr, ur, triangleDistance) && triangleDistance < distance) {
+        distance = triangleDistance;
+        normal = faceNormalAt(x, y, 1);
+        hit = true;
+    }
+
+    return hit;
+}
+
+TerrainHit HeightMap::raycast(const glm::vec3 &origin, const glm::vec3 &direction, float maximumDistance) const {
+    TerrainHit result;
+    if (glm::length(direction) == 0.0f) {
+        return result;
+    }
+    glm::vec3 normalizedDirection = glm::normalize(direction);
+
+    struct Block {
+        int level;
+        int x;
+        int y;
+        float entry;
+    };
+
+    // intersection of the ray with the bounding box of a block
+    auto enterBlock = [&](int level, int x, int y, Block &block) {
+        int firstX, firstY, lastX, lastY;
+        getBlockBounds(level, x, y, firstX, firstY, lastX, lastY);
+
+        const PyramidLevel &pyramidLevel = pyramid[level];
+        glm::vec3 minimum((float) firstX, pyramidLevel.minimum[y * pyramidLevel.width + x], (float) firstY);
+        glm::vec3 maximum((float) lastX, pyramidLevel.maximum[y * pyramidLevel.width + x], (float) lastY);
+
+        float exit;
+        block = {level, x, y, 0.0f};
+        return intersectBox(origin, normalizedDirection, minimum, maximum, block.entry, exit)
+               && block.entry <= maximumDistance;
+    };
+
+    // depth-first from the top, nearest blocks first, skipping blocks behind the nearest hit
+    float distance = maximumDistance;
+    std::vector<Block> stack;
+
+    Block root;
+    if (enterBlock(pyramid.size() - 1, 0, 0, root)) {
+        stack.push_back(root);
+    }
+
+    while (!stack.empty()) {
+        Block block = stack.back();
+        stack.pop_back();
+
+        if (block.entry > distance) {
+            continue;
+        }
+
+        if (block.level == 0) {
+            int firstX, firstY, lastX, lastY;
+            getBlockBounds(0, block.x, block.y, firstX, firstY, lastX, lastY);
+
+            for (int y = firstY; y < lastY; ++y) {
+                for (int x = firstX; x < lastX; ++x) {
+                    if (intersectSquare(origin, normalizedDirection, x, y, distance, result.normal)) {
+                        result.hit = true;
+                    }
+                }
+            }
+            continue;
+        }
+
+        const PyramidLevel &below = pyramid[block.level - 1];
+        Block children[4];
+        int numberOfChildren = 0;
+
+        for (int y = 2 * block.y; y <= std::min(2 * block.y + 1, below.depth - 1); ++y) {
+            for (int x = 2 * block.x; x <= std::min(2 * block.x + 1, below.width - 1); ++x) {
+                if (enterBlock(block.level - 1, x, y, children[numberOfChildren])) {
+                    ++numberOfChildren;
+                }
+            }
+        }
+
+        // push the farthest child first so that the nearest one is processed next,
+        // insertion sort since there are at most four of them
+        for (int i = 1; i < numberOfChildren; ++i) {
+            Block child = children[i];
+            int j = i;
+            for (; j > 0 && children[j - 1].entry < child.entry; --j) {
+                children[j] = children[j - 1];
+            }
+            children[j] = child;
+        }
+        stack.insert(stack.end(), children, children + numberOfChildren);
+    }
 
+    if (result.hit) {
+        result.distance = distance;
+        result.position = origin + distance * normalizedDirection;
+    }
+
+    return result;
+}
@@ -1,28 +1,100 @@
 #ifndef HEIGHTMAP_H
 #define HEIGHTMAP_H
 
+#include <functional>
 #include <iostream>
+#include <limits>
+#include <vector>
 #include <glm/glm.hpp>
 
-#include "mesh.h"
+#include "terrainnoise.h"
+
+// writes the heights of width x depth world grid points starting at (originX, originY)
+// in row-major order, has to be thread-safe since terrain chunks are filled on worker threads
+typedef std::function<void(int originX, int originY, int width, int depth, float *heights)> HeightGenerator;
+
+// result of a ray cast against the terrain
+struct TerrainHit {
+    bool hit = false;
+    float distance = 0.0f; // along the normalized ray direction
+    glm::vec3 position;
+    glm::vec3 normal;
+};
 
 class HeightMap {
 private:
-    float **heightMap;
-    glm::vec3 ***normals;
+    // number of samples along x and y
+    int width;
+    int depth;
+
+    // heights in row-major order, one row per y coordinate
+    std::vector<float> heights;
+
+    // bounds-checked access to the flat buffer
+    float& heightAt(int x, int y);
+    float heightAt(int x, int y) const;
+
+    // normals of the two triangles of every square in row-major order, one row of
+    // (width - 1) squares per y coordinate, kept up to date by updatePyramid
+    std::vector<glm::vec3> faceNormals;
+
+    // bounds-checked access to the face normal of one of the two triangles of the square
+    // with lower left corner (x, y)
+    glm::vec3& faceNormalAt(int x, int y, int triangle);
+    const glm::vec3& faceNormalAt(int x, int y, int triangle) const;
 
-    glm::vec3 computeNormal(unsigned int x, unsigned int y);
+    glm::vec3 computeFaceNormal(int x, int y, int triangle) const;
+
+    // min/max pyramid: level 0 holds the lowest and highest height of every block of
+    // PYRAMID_BLOCK_SIZE x PYRAMID_BLOCK_SIZE squares, every further level combines 2x2 blocks
+    // of the level below, up to a single block for the whole map
+    struct PyramidLevel {
+        int width;
+        int depth;
+        std::vector<float> minimum;
+        std::vector<float> maximum;
+    };
+    std::vector<PyramidLevel> pyramid;
+
+    void setUpPyramid();
+    // the grid points of a block at a pyramid level (clamped to the map)
+    void getBlockBounds(int level, int x, int y, int &firstX, int &firstY, int &lastX, int &lastY) const;
+    // nearest intersection with one of the two triangles of the square (x, y) closer than distance
+    bool intersectSquare(const glm::vec3 &origin, const glm::vec3 &direction, int x, int y,
+                         float &distance, glm::vec3 &normal) const;
 
 public:
-    static const int SIZE = 200;
+    static const int PYRAMID_BLOCK_SIZE = 4;
+
+    HeightMap(int width, int depth);
 
-    HeightMap();
-    ~HeightMap();
+    int getWidth() const;
+    int getDepth() const;
 
-    void generateMap();
-    Mesh generateMesh();
+    // fill the map with the noise heights of the grid points starting at (originX, originY)
+    void generateMap(const TerrainNoise &noise, int originX = 0, int originY = 0);
+    // fill the map with the heights of the generator, starting at (originX, originY)
+    void fillMap(const HeightGenerator &generator, int originX = 0, int originY = 0);
+
+    // height at a grid point
+    float getHeightAt(int x, int y) const;
+    // the pyramid does not follow single heights, update it once all of them are set
+    void setHeightAt(int x, int y, float height);
+    // smooth normal at a grid point, average of the normals of all adjacent triangles
+    glm::vec3 getNormal(int x, int y) const;
+    // bilinearly interpolated height, -infinity outside of the map
     float getHeight(float x, float y) const;
+    // the same for count positions at once, results[i] is the height at (xs[i], ys[i]),
+    // eight (AVX2, make SIMD=avx2) or four (SSE2) at a time
+    void getHeights(const float *xs, const float *ys, float *results, int count) const;
+
+    // recompute the face normals and the pyramid above the grid points
+    // from (firstX, firstY) to (lastX, lastY)
+    void updatePyramid(int firstX, int firstY, int lastX, int lastY);
+    // first intersection of the ray with the terrain within maximumDistance, skips all
+    // blocks of the pyramid that the ray passes above or below
+    TerrainHit raycast(const glm::vec3 &origin, const glm::vec3 &direction,
+                       float maximumDistance = std::numeric_limits<float>::infinity()) const;
 };
 
 #endif
-
@@ -0,0 +1,229 @@
+#include "heightmapfile.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "heightmap.h"
+
+static const char HEIGHT_MAP_MAGIC[4] = {'O', 'G', 'L', 'H'};
+static const uint32_t HEIGHT_MAP_VERSION = 1;
+static const size_t HEIGHT_MAP_HEADER_SIZE = 36;
+
+// the file is little-endian on every machine, so values are written and read byte by byte
+static void writeValue(std::ofstream &file, uint64_t value, int bytes) {
+    for (int i = 0; i < bytes; ++i) {
+        file.put((char)((value >> (8 * i)) & 0xff));
+    }
+}
+
+static void writeFloat(std::ofstream &file, float value) {
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    writeValue(file, bits, 4);
+}
+
+static uint64_t readValue(const unsigned char *data, int bytes) {
+    uint64_t value = 0;
+    for (int i = 0; i < bytes; ++i) {
+        value |= (uint64_t)data[i] << (8 * i);
+    }
+    return value;
+}
+
+static float readFloat(const unsigned char *data) {
+    uint32_t bits = (uint32_t)readValue(data, 4);
+    float value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+bool HeightMapFile::save(const std::string &path, const HeightMap &map, int tileSize) {
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file) {
+        std::cerr << "ERROR::HEIGHTMAPFILE::FILE_NOT_SUCCESSFULLY_OPENED " << path << std::endl;
+        return false;
+    }
+
+    int width = map.getWidth();
+    int depth = map.getDepth();
+    int tilesX = (width + tileSize - 1) / tileSize;
+    int tilesY = (depth + tileSize - 1) / tileSize;
+
+    // quantize to 16 bits between the lowest and the highest point
+    float minimumHeight = map.getHeightAt(0, 0);
+    float maximumHeight = minimumHeight;
+    for (int y = 0; y < depth; ++y) {
+        for (int x = 0; x < width; ++x) {
+            minimumHeight = std::min(minimumHeight, map.getHeightAt(x, y));
+            maximumHeight = std::max(maximumHeight, map.getHeightAt(x, y));
+        }
+    }
+    float heightStep = (maximumHeight - minimumHeight) / 65535.0f;
+
+    file.write(HEIGHT_MAP_MAGIC, sizeof(HEIGHT_MAP_MAGIC));
+    writeValue(file, HEIGHT_MAP_VERSION, 4);
+    writeValue(file, width, 4);
+    writeValue(file, depth, 4);
+    writeValue(file, tileSize, 4);
+    writeFloat(file, minimumHeight);
+    writeFloat(file, heightStep);
+    writeValue(file, tilesX, 4);
+    writeValue(file, tilesY, 4);
+
+    uint64_t tileBytes = (uint64_t)tileSize * tileSize * sizeof(uint16_t);
+    uint64_t firstTile = HEIGHT_MAP_HEADER_SIZE + (uint64_t)tilesX * tilesY * sizeof(uint64_t);
+    for (int tile = 0; tile < tilesX * tilesY; ++tile) {
+        writeValue(file, firstTile + tile * tileBytes, 8);
+    }
+
+    for (int tileY = 0; tileY < tilesY; ++tileY) {
+        for (int tileX = 0; tileX < tilesX; ++tileX) {
+            for (int y = 0; y < tileSize; ++y) {
+                for (int x = 0; x < tileSize; ++x) {
+                    float height = map.getHeightAt(std::min(tileX * tileSize + x, width - 1),
+                                                   std::min(tileY * tileSize + y, depth - 1));
+                    float quantized = (heightStep > 0.0f) ? std::round((height - minimumHeight) / heightStep) : 0.0f;
+
+                    writeValue(file, (uint16_t)std::min(quantized, 65535.0f), 2);
+                }
+            }
+        }
+    }
+
+    if (!file) {
+        std::cerr << "ERROR::HEIGHTMAPFILE::WRITING_FAILED " << path << std::endl;
+        return false;
+    }
+
+    std::cout << "INFO::HEIGHTMAPFILE Saved " << width << "x" << depth << " heights to " << path << std::endl;
+
+    return true;
+}
+
+HeightMapFile::~HeightMapFile() {
+    close();
+}
+
+bool HeightMapFile::open(const std::string &path) {
+    close();
+
+    fileDescriptor = ::open(path.c_str(), O_RDONLY);
+    if (fileDescriptor < 0) {
+        std::cerr << "ERROR::HEIGHTMAPFILE::FILE_NOT_SUCCESSFULLY_OPENED " << path << std::endl;
+        return false;
+    }
+
+    struct stat status;
+    if (fstat(fileDescriptor, &status) != 0 || (size_t)status.st_size < HEIGHT_MAP_HEADER_SIZE) {
+        std::cerr << "ERROR::HEIGHTMAPFILE::INVALID_FILE " << path << std::endl;
+        close();
+        return false;
+    }
+    size = status.st_size;
+
+    void *mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fileDescriptor, 0);
+    if (mapping == MAP_FAILED) {
+        std::cerr << "ERROR::HEIGHTMAPFILE::MAPPING_FAILED " << path << std::endl;
+        data = nullptr;
+        close();
+        return false;
+    }
+    data = (const unsigned char*)mapping;
+
+    width = (int)readValue(data + 8, 4);
+    depth = (int)readValue(data + 12, 4);
+    tileSize = (int)readValue(data + 16, 4);
+    minimumHeight = readFloat(data + 20);
+    heightStep = readFloat(data + 24);
+    tilesX = (int)readValue(data + 28, 4);
+    tilesY = (int)readValue(data + 32, 4);
+    tileTable = data + HEIGHT_MAP_HEADER_SIZE;
+
+    // sizes are computed in 64 bits, so that no header can make them overflow
+    bool valid = std::memcmp(data, HEIGHT_MAP_MAGIC, sizeof(HEIGHT_MAP_MAGIC)) == 0
+                 && readValue(data + 4, 4) == HEIGHT_MAP_VERSION
+                 && width > 1 && depth > 1 && tileSize > 0 && tilesX > 0 && tilesY > 0
+                 && (uint64_t)tilesX == ((uint64_t)width + tileSize - 1) / tileSize
+                 && (uint64_t)tilesY == ((uint64_t)depth + tileSize - 1) / tileSize;
+
+    // the tile table has to lie within the file
+    uint64_t numberOfTiles = valid ? (uint64_t)tilesX * tilesY : 0;
+    valid = valid && numberOfTiles <= (size - HEIGHT_MAP_HEADER_SIZE) / sizeof(uint64_t);
+
+    // every tile has to lie within the file
+    uint64_t tileBytes = (uint64_t)tileSize * tileSize * sizeof(uint16_t);
+    for (uint64_t tile = 0; valid && tile < numberOfTiles; ++tile) {
+        uint64_t offset = readValue(tileTable + tile * sizeof(uint64_t), 8);
+        valid = offset <= size && tileBytes <= size - offset;
+    }
+
+    if (!valid) {
+        std::cerr << "ERROR::HEIGHTMAPFILE::INVALID_FILE " << path << std::endl;
+        close();
+        return false;
+    }
+
+    std::cout << "INFO::HEIGHTMAPFILE Mapped " << width << "x" << depth << " heights from " << path << std::endl;
+
+    return true;
+}
+
+void HeightMapFile::close() {
+    if (data) {
+        munmap((void*)data, size);
+        data = nullptr;
+    }
+    if (fileDescriptor >= 0) {
+        ::close(fileDescriptor);
+        fileDescriptor = -1;
+    }
+    size = 0;
+}
+
+bool HeightMapFile::isOpen() const {
+    return data != nullptr;
+}
+
+int HeightMapFile::getWidth() const {
+    return width;
+}
+
+int HeightMapFile::getDepth() const {
+    return depth;
+}
+
+const unsigned char* HeightMapFile::getTile(int tileX, int tileY) const {
+    return data + readValue(tileTable + ((uint64_t)tileY * tilesX + tileX) * sizeof(uint64_t), 8);
+}
+
+void HeightMapFile::read(int originX, int originY, int width, int depth, float *heights) const {
+    for (int y = 0; y < depth; ++y) {
+        int mapY = std::min(std::max(originY + y, 0), this->depth - 1);
+        int tileY = mapY / tileSize;
+        size_t rowOffset = (size_t)(mapY % tileSize) * tileSize;
+
+        // look up the tile only when the row crosses into the next one
+        int currentTileX = -1;
+        const unsigned char *tile = nullptr;
+
+        for (int x = 0; x < width; ++x) {
+            int mapX = std::min(std::max(originX + x, 0), this->width - 1);
+            if (mapX / tileSize != currentTileX) {
+                currentTileX = mapX / tileSize;
+                tile = getTile(currentTileX, tileY);
+            }
+
+            const unsigned char *sample = tile + (rowOffset + mapX % tileSize) * sizeof(uint16_t);
+
+            heights[y * width + x] = minimumHeight + heightStep * (float)readValue(sample, 2);
+        }
+    }
+}
@@ -0,0 +1,56 @@
+#ifndef HEIGHTMAPFILE_H
+#define HEIGHTMAPFILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+class HeightMap;
+
+// height map on disk, memory-mapped and read per tile so that only the touched parts are paged in
+//
+// layout (little-endian): magic "OGLH", version, width, depth, tile size, minimum height,
+// height step, tiles along x and y, one 64-bit file offset per tile (row-major), and the tiles
+// with tile size x tile size quantized 16-bit heights each; tiles at the far borders repeat
+// the last row and column of the map
+class HeightMapFile {
+private:
+    int fileDescriptor = -1;
+    const unsigned char *data = nullptr;
+    size_t size = 0;
+
+    int width = 0;
+    int depth = 0;
+    int tileSize = 0;
+    float minimumHeight = 0.0f;
+    float heightStep = 0.0f;
+    int tilesX = 0;
+    int tilesY = 0;
+    const unsigned char *tileTable = nullptr;
+
+    const unsigned char* getTile(int tileX, int tileY) const;
+
+public:
+    static const int DEFAULT_TILE_SIZE = 64;
+
+    HeightMapFile() = default;
+    ~HeightMapFile();
+
+    HeightMapFile(const HeightMapFile&) = delete;
+    HeightMapFile& operator=(const HeightMapFile&) = delete;
+
+    static bool save(const std::string &path, const HeightMap &map, int tileSize = DEFAULT_TILE_SIZE);
+
+    bool open(const std::string &path);
+    void close();
+    bool isOpen() const;
+
+    int getWidth() const;
+    int getDepth() const;
+
+    // heights of width x depth grid points starting at (originX, originY), row-major,
+    // points outside of the map get the height of the nearest border point
+    void read(int originX, int originY, int width, int depth, float *heights) const;
+};
+
+#endif
@@ -0,0 +1,101 @@
+#include "input.h"
+
+#include <cstring>
+#include <iostream>
+
+// log layout: magic, version, and then one record per frame
+// (delta time, key mask, mouse x/y offset, scroll offset), all in host byte order
+static const char INPUT_LOG_MAGIC[4] = {'O', 'G', 'L', 'I'};
+static const uint32_t INPUT_LOG_VERSION = 1;
+
+bool InputFrame::isPressed(InputKey key) const {
+    return (keys & key) != 0;
+}
+
+bool InputRecorder::open(const std::string &path) {
+    file.open(path, std::ios::binary | std::ios::trunc);
+    if (!file) {
+        std::cerr << "ERROR::INPUT::LOG_NOT_SUCCESSFULLY_OPENED " << path << std::endl;
+        return false;
+    }
+
+    file.write(INPUT_LOG_MAGIC, sizeof(INPUT_LOG_MAGIC));
+    file.write((const char*)&INPUT_LOG_VERSION, sizeof(INPUT_LOG_VERSION));
+
+    return true;
+}
+
+void InputRecorder::record(const InputFrame &frame) {
+    file.write((const char*)&frame.deltaTime, sizeof(frame.deltaTime));
+    file.write((const char*)&frame.keys, sizeof(frame.keys));
+    file.write((const char*)&frame.mouseXOffset, sizeof(frame.mouseXOffset));
+    file.write((const char*)&frame.mouseYOffset, sizeof(frame.mouseYOffset));
+    file.write((const char*)&frame.scrollOffset, sizeof(frame.scrollOffset));
+}
+
+void InputRecorder::close() {
+    file.close();
+}
+
+bool InputRecorder::isOpen() const {
+    return file.is_open();
+}
+
+bool InputReplay::load(const std::string &path) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        std::cerr << "ERROR::INPUT::LOG_NOT_SUCCESSFULLY_OPENED " << path << std::endl;
+        return false;
+    }
+
+    char magic[4];
+    uint32_t version;
+    file.read(magic, sizeof(magic));
+    file.read((char*)&version, sizeof(version));
+
+    if (!file || std::memcmp(magic, INPUT_LOG_MAGIC, sizeof(magic)) != 0 || version != INPUT_LOG_VERSION) {
+        std::cerr << "ERROR::INPUT::INVALID_LOG " << path << std::endl;
+        return false;
+    }
+
+    frames.clear();
+    nextFrame = 0;
+
+    while (true) {
+        InputFrame frame;
+        file.read((char*)&frame.deltaTime, sizeof(frame.deltaTime));
+        file.read((char*)&frame.keys, sizeof(frame.keys));
+        file.read((char*)&frame.mouseXOffset, sizeof(frame.mouseXOffset));
+        file.read((char*)&frame.mouseYOffset, sizeof(frame.mouseYOffset));
+        file.read((char*)&frame.scrollOffset, sizeof(frame.scrollOffset));
+
+        if (!file) {
+            break;
+        }
+        frames.push_back(frame);
+    }
+
+    std::cout << "INFO::INPUT Loaded " << frames.size() << " frames from " << path << std::endl;
+
+    return true;
+}
+
+void InputReplay::setFixedTimestep(float seconds) {
+    fixedTimestep = seconds;
+}
+
+bool InputReplay::hasNext() const {
+    return nextFrame < frames.size();
+}
+
+InputFrame InputReplay::next() {
+    InputFrame frame = frames[nextFrame++];
+    if (fixedTimestep > 0.0f) {
+        frame.deltaTime = fixedTimestep;
+    }
+    return frame;
+}
+
+unsigned int InputReplay::size() const {
+    return frames.size();
+}
@@ -0,0 +1,65 @@
+#ifndef INPUT_H
+#define INPUT_H
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// keys that influence the game, stored as bit mask per frame
+enum InputKey : uint16_t {
+    KEY_FORWARD    = 1 << 0,
+    KEY_BACKWARD   = 1 << 1,
+    KEY_LEFT       = 1 << 2,
+    KEY_RIGHT      = 1 << 3,
+    KEY_UPWARD     = 1 << 4,
+    KEY_DOWNWARD   = 1 << 5,
+    KEY_SPRINT     = 1 << 6,
+    KEY_FOLLOW     = 1 << 7,
+    KEY_FLASHLIGHT = 1 << 8,
+    KEY_CRATER     = 1 << 9,
+    KEY_SELECT     = 1 << 10
+};
+
+// everything the game reads from the user during one frame
+struct InputFrame {
+    float deltaTime = 0.0f;
+    uint16_t keys = 0;
+    float mouseXOffset = 0.0f;
+    float mouseYOffset = 0.0f;
+    float scrollOffset = 0.0f;
+
+    bool isPressed(InputKey key) const;
+};
+
+// writes input frames to a binary log
+class InputRecorder {
+private:
+    std::ofstream file;
+
+public:
+    bool open(const std::string &path);
+    void record(const InputFrame &frame);
+    void close();
+    bool isOpen() const;
+};
+
+// reads a binary log and hands out its input frames one after another
+class InputReplay {
+private:
+    std::vector<InputFrame> frames;
+    unsigned int nextFrame = 0;
+    // replaces the recorded timesteps if not 0
+    float fixedTimestep = 0.0f;
+
+public:
+    bool load(const std::string &path);
+    // feed the frames back with the same timestep, so that runs of different recordings
+    // simulate comparable frames
+    void setFixedTimestep(float seconds);
+    bool hasNext() const;
+    InputFrame next();
+    unsigned int size() const;
+};
+
+#endif
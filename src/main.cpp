@@ -6,24 +6,48 @@
 #include <glm/gtx/string_cast.hpp>
 #include <stb_image.h>
 
-#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <cerrno>
+#include <climits>
 #include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
 
 #include "gl.h"
+#include "glstate.h"
 
 #include "game.h"
+#include "headless.h"
+#include "heightmapfile.h"
+#include "input.h"
+#include "shader.h"
 
 #include "constants.h"
 
+const int WINDOW_WIDTH = 1280;
+const int WINDOW_HEIGHT = 720;
+// timestep of headless runs and of --fixed-step replays
+const float FIXED_TIMESTEP = 1.0f / 60.0f;
+
 float deltaTime = 0.0f;
 float lastFrame = 0.0f;
+float gameTime = 0.0f;
 
 float lastX = 640;
 float lastY = 360;
 bool firstMouse = true;
 
-bool keyCPressed = false;
-bool keyFPressed = false;
+// mouse and scroll offsets collected by the callbacks until the next frame
+float pendingMouseXOffset = 0.0f;
+float pendingMouseYOffset = 0.0f;
+float pendingScrollOffset = 0.0f;
+
+// keys of the previous frame, used to detect key presses
+uint16_t previousKeys = 0;
 
 Game *gamePtr;
 
@@ -36,6 +60,9 @@ void setUpLightingShader(Shader &shader,
 void framebuffer_size_callback(GLFWwindow *window, int width, int height) {
     std::cout << "framebuffer_size_callback " << width << "x" << height << std::endl;
     glViewport(0, 0, width, height);
+    if (gamePtr) {
+        gamePtr->setViewportSize(width, height);
+    }
 }
 
 void mouse_callback(GLFWwindow *window, double xpos, double ypos) {
@@ -50,81 +77,165 @@ void mouse_callback(GLFWwindow *window, double xpos, double ypos) {
     lastX = xpos;
     lastY = ypos;
     
-    gamePtr->camera.processDirectionChange(xoffset,  yoffset);
+    pendingMouseXOffset += xoffset;
+    pendingMouseYOffset += yoffset;
 }
 
 void scroll_callback(GLFWwindow *window, double xoffset, double yoffset) {
-    gamePtr->camera.adjustDistance(-0.5f * (float)yoffset);
+    pendingScrollOffset += (float)yoffset;
 }
 
-void processInput(GLFWwindow *window) {
+// collect the input of the current frame from GLFW
+InputFrame pollInput(GLFWwindow *window) {
     if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS) {
         glfwSetWindowShouldClose(window, true);
     }
 
+    const struct {
+        int glfwKey;
+        InputKey key;
+    } keyMapping[] = {
+        {GLFW_KEY_W, KEY_FORWARD},
+        {GLFW_KEY_S, KEY_BACKWARD},
+        {GLFW_KEY_A, KEY_LEFT},
+        {GLFW_KEY_D, KEY_RIGHT},
+        {GLFW_KEY_SPACE, KEY_UPWARD},
+        {GLFW_KEY_LEFT_CONTROL, KEY_DOWNWARD},
+        {GLFW_KEY_LEFT_SHIFT, KEY_SPRINT},
+        {GLFW_KEY_C, KEY_FOLLOW},
+        {GLFW_KEY_F, KEY_FLASHLIGHT},
+        {GLFW_KEY_X, KEY_CRATER},
+        {GLFW_KEY_E, KEY_SELECT}
+    };
+
+    InputFrame frame;
+    frame.deltaTime = deltaTime;
+
+    for (const auto &mapping : keyMapping) {
+        if (glfwGetKey(window, mapping.glfwKey) == GLFW_PRESS) {
+            frame.keys |= mapping.key;
+        }
+    }
+
+    frame.mouseXOffset = pendingMouseXOffset;
+    frame.mouseYOffset = pendingMouseYOffset;
+    frame.scrollOffset = pendingScrollOffset;
+    pendingMouseXOffset = 0.0f;
+    pendingMouseYOffset = 0.0f;
+    pendingScrollOffset = 0.0f;
 
-    if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS) {
-        gamePtr->camera.processMovement(Direction::FORWARD, deltaTime);
+    return frame;
+}
+
+// apply the input of one frame to the game, independent of where it came from
+void processInput(const InputFrame &frame) {
+    if (frame.mouseXOffset != 0.0f || frame.mouseYOffset != 0.0f) {
+        gamePtr->camera.processDirectionChange(frame.mouseXOffset, frame.mouseYOffset);
+    }
+
+    if (frame.scrollOffset != 0.0f) {
+        gamePtr->camera.adjustDistance(-0.5f * frame.scrollOffset);
     }
 
-    if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS) {
-        gamePtr->camera.processMovement(Direction::BACKWARD, deltaTime);
+    if (frame.isPressed(KEY_FORWARD)) {
+        gamePtr->camera.processMovement(Direction::FORWARD, frame.deltaTime);
     }
 
-    if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS) {
-        gamePtr->camera.processMovement(Direction::LEFT, deltaTime);
+    if (frame.isPressed(KEY_BACKWARD)) {
+        gamePtr->camera.processMovement(Direction::BACKWARD, frame.deltaTime);
     }
 
-    if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS) {
-        gamePtr->camera.processMovement(Direction::RIGHT, deltaTime);
+    if (frame.isPressed(KEY_LEFT)) {
+        gamePtr->camera.processMovement(Direction::LEFT, frame.deltaTime);
     }
 
-    gamePtr->camera.setSprinting(glfwGetKey(window, GLFW_KEY_LEFT_SHIFT) == GLFW_PRESS);
+    if (frame.isPressed(KEY_RIGHT)) {
+        gamePtr->camera.processMovement(Direction::RIGHT, frame.deltaTime);
+    }
+
+    gamePtr->camera.setSprinting(frame.isPressed(KEY_SPRINT));
     
-    if (glfwGetKey(window, GLFW_KEY_SPACE) == GLFW_PRESS) {
-        gamePtr->camera.processMovement(Direction::UPWARD, deltaTime);
+    if (frame.isPressed(KEY_UPWARD)) {
+        gamePtr->camera.processMovement(Direction::UPWARD, frame.deltaTime);
+    }
+
+    if (frame.isPressed(KEY_DOWNWARD)) {
+        gamePtr->camera.processMovement(Direction::DOWNWARD, frame.deltaTime);
     }
 
-    if (glfwGetKey(window, GLFW_KEY_LEFT_CONTROL) == GLFW_PRESS) {
-        gamePtr->camera.processMovement(Direction::DOWNWARD, deltaTime);
+    // toggles only react to the frame in which the key went down
+    uint16_t pressedKeys = frame.keys & ~previousKeys;
+    previousKeys = frame.keys;
+
+    if (pressedKeys & KEY_FOLLOW) {
+        gamePtr->camera.setFollowing(!gamePtr->camera.isFollowing());
     }
 
-    if (glfwGetKey(window, GLFW_KEY_Q) == GLFW_PRESS) {
-        //gamePtr->camera.velocity += -0.22f;
+    if (pressedKeys & KEY_FLASHLIGHT) {
+        gamePtr->flashlight = !gamePtr->flashlight;
     }
 
-    if (glfwGetKey(window, GLFW_KEY_C) == GLFW_PRESS) {
-        if (!keyCPressed) {
-            gamePtr->camera.setFollowing(!gamePtr->camera.isFollowing());
-            keyCPressed = true;
-        }
-    } else {
-        keyCPressed = false;
+    if (pressedKeys & KEY_CRATER) {
+        gamePtr->blastCrater();
     }
-    
 
-    if (glfwGetKey(window, GLFW_KEY_F) == GLFW_PRESS) {
-        if (!keyFPressed) {
-            gamePtr->flashlight = !gamePtr->flashlight;
-            keyFPressed = true;
-        }
-    } else {
-        keyFPressed = false;
+    if (pressedKeys & KEY_SELECT) {
+        gamePtr->selectObject();
     }
 }
 
-int main(int argc, char *argv[]) {
-    stbi_set_flip_vertically_on_load(true);
+// checksum of the current framebuffer content, identical frames have identical checksums
+uint32_t framebufferChecksum(int width, int height) {
+    std::vector<unsigned char> pixels(width * height * 4);
+    glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+
+    // FNV-1a
+    uint32_t hash = 2166136261u;
+    for (unsigned char pixel : pixels) {
+        hash = (hash ^ pixel) * 16777619u;
+    }
+
+    return hash;
+}
+
+// clear color, depth, and stencil buffer
+void clearFrame() {
+    glClearColor(0.0f, 0.0f, 0.0f, 1.0f); // state-setting function
+    glStencilMask(0xFF); // Enable writing to stencil buffer
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT); // state-using function
+    glStencilMask(0x00); // Disable writing to stencil buffer
+}
 
+void setUpGLState() {
+    // redundant binds and state changes are dropped from here on
+    GLStateCache::install();
+
+    setUpDebugOutput();
+
+    int nrAttributes;
+    glGetIntegerv(GL_MAX_VERTEX_ATTRIBS, &nrAttributes);
+    std::cout << "Maximum number of vertex attributes supported: " << nrAttributes << std::endl;
+
+    glEnable(GL_DEPTH_TEST);
+    glEnable(GL_STENCIL_TEST);
+
+    // wireframe mode
+    //glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+}
+
+int runWindowed(const GameSettings &settings, InputRecorder &recorder, InputReplay &replay) {
     glfwInit();
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+#if GL_ERROR_CHECKING >= 2
+    glfwWindowHint(GLFW_OPENGL_DEBUG_CONTEXT, GL_TRUE);
+#endif
 
     // the following is only needed on MacOS
     //glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
 
-    GLFWwindow *window = glfwCreateWindow(1280, 720, "LearnOpenGL", nullptr, nullptr);
+    GLFWwindow *window = glfwCreateWindow(WINDOW_WIDTH, WINDOW_HEIGHT, "LearnOpenGL", nullptr, nullptr);
     if (window == nullptr) {
         std::cerr << "Failed to create GLFW window" << std::endl;
         glfwTerminate();
@@ -137,24 +248,24 @@ int main(int argc, char *argv[]) {
         return -1;
     }
     
-    glViewport(0, 0, 1280, 720);
+    glViewport(0, 0, WINDOW_WIDTH, WINDOW_HEIGHT);
     glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
     glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
     glfwSetCursorPosCallback(window, mouse_callback);
     glfwSetScrollCallback(window, scroll_callback);
 
-    int nrAttributes;
-    glGetIntegerv(GL_MAX_VERTEX_ATTRIBS, &nrAttributes);
-    std::cout << "Maximum number of vertex attributes supported: " << nrAttributes << std::endl;
+    setUpGLState();
 
-    glEnable(GL_DEPTH_TEST);
-    glEnable(GL_STENCIL_TEST);
+    // the game releases its GL objects before the context is terminated
+    gamePtr = new Game(settings);
+    Game &game = *gamePtr;
 
-    // wireframe mode
-    //glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+    int framebufferWidth, framebufferHeight;
+    glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
+    game.setViewportSize(framebufferWidth, framebufferHeight);
 
-    Game game;
-    gamePtr = &game;
+    // edited shaders are rebuilt while the game runs
+    Shader::watchSourceFiles();
 
     // render loop
     while (!glfwWindowShouldClose(window)) {
@@ -162,21 +273,31 @@ int main(int argc, char *argv[]) {
         deltaTime = currentFrame - lastFrame;
         lastFrame = currentFrame;
 
-        // process input
-        processInput(window);
+        // process input (live or from a replay, which also dictates the timestep)
+        InputFrame input = pollInput(window);
+        if (replay.hasNext()) {
+            input = replay.next();
+        }
+        if (recorder.isOpen()) {
+            recorder.record(input);
+        }
+
+        deltaTime = input.deltaTime;
+        gameTime += deltaTime;
+
+        processInput(input);
         game.simulateGravity(deltaTime);
 
+        Shader::reloadChangedShaders();
+
         glCheckError();
 
         // rendering
-        glClearColor(0.0f, 0.0f, 0.0f, 1.0f); // state-setting function
-        glStencilMask(0xFF); // Enable writing to stencil buffer
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT); // state-using function
-        glStencilMask(0x00); // Disable writing to stencil buffer
+        clearFrame();
 
         glCheckError();
 
-        game.processGameLogic((float)glfwGetTime());
+        game.processGameLogic(gameTime);
 
         game.setUpShaders();
 
@@ -185,6 +306,8 @@ int main(int argc, char *argv[]) {
         game.draw();
 
         glCheckError();
+        // the whole frame at once, also when the checks above are compiled out
+        glCheckFrameError();
 
         // swap buffers
         glfwSwapBuffers(window);
@@ -193,8 +316,263 @@ int main(int argc, char *argv[]) {
         glfwPollEvents();
     }
 
+    recorder.close();
+    delete gamePtr;
+    gamePtr = nullptr;
     glfwTerminate();
 
     return 0;
 }
 
+double millisecondsSince(std::chrono::steady_clock::time_point start) {
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count();
+}
+
+void printTimings(const char *name, const std::vector<double> &timings) {
+    double sum = 0.0;
+    double minimum = timings[0];
+    double maximum = timings[0];
+    for (double timing : timings) {
+        sum += timing;
+        minimum = std::min(minimum, timing);
+        maximum = std::max(maximum, timing);
+    }
+
+    std::cout << "INFO::HEADLESS " << name
+              << " avg " << sum / timings.size() << " ms"
+              << " min " << minimum << " ms"
+              << " max " << maximum << " ms" << std::endl;
+}
+
+int runHeadless(int frames, const GameSettings &settings, InputReplay &replay) {
+    HeadlessContext context(WINDOW_WIDTH, WINDOW_HEIGHT);
+    if (!context.create()) {
+        return -1;
+    }
+
+    setUpGLState();
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    Game game(settings);
+    gamePtr = &game;
+    game.setViewportSize(context.getWidth(), context.getHeight());
+    std::cout << "INFO::HEADLESS Game setup " << millisecondsSince(start) << " ms" << std::endl;
+
+    // a replay runs until its end, unless the number of frames is limited explicitly
+    if (frames < 0) {
+        frames = (replay.size() > 0) ? replay.size() : 100;
+    }
+
+    std::vector<double> setUpShadersTimings;
+    std::vector<double> drawTimings;
+    std::vector<double> frameTimings;
+    unsigned long long terrainTriangles = 0;
+    unsigned long long terrainChunks = 0;
+    unsigned long long visibleObjects = 0;
+    unsigned long long occludedChunks = 0;
+    unsigned long long occludedObjects = 0;
+    unsigned long long drawCalls = 0;
+    unsigned long long stateChanges = 0;
+    unsigned long long issuedGLCalls = GLStateCache::getNumberOfIssuedCalls();
+    unsigned long long skippedGLCalls = GLStateCache::getNumberOfSkippedCalls();
+
+    for (int frame = 0; frame < frames; ++frame) {
+        std::chrono::steady_clock::time_point frameStart = std::chrono::steady_clock::now();
+
+        // fixed timestep (or the recorded one), so that every run simulates exactly the same frames
+        InputFrame input;
+        input.deltaTime = FIXED_TIMESTEP;
+        if (replay.hasNext()) {
+            input = replay.next();
+        }
+
+        deltaTime = input.deltaTime;
+        gameTime += deltaTime;
+
+        processInput(input);
+        game.simulateGravity(deltaTime);
+
+        clearFrame();
+
+        game.processGameLogic(gameTime);
+
+        start = std::chrono::steady_clock::now();
+        game.setUpShaders();
+        setUpShadersTimings.push_back(millisecondsSince(start));
+
+        // wait for the GPU, otherwise we would only measure command submission
+        start = std::chrono::steady_clock::now();
+        game.draw();
+        glFinish();
+        drawTimings.push_back(millisecondsSince(start));
+
+        glCheckFrameError();
+
+        frameTimings.push_back(millisecondsSince(frameStart));
+        terrainTriangles += game.getTerrain().getNumberOfDrawnTriangles();
+        terrainChunks += game.getTerrain().getNumberOfDrawnChunks();
+        visibleObjects += game.getNumberOfVisibleObjects();
+        occludedChunks += game.getTerrain().getNumberOfOccludedChunks();
+        occludedObjects += game.getNumberOfOccludedObjects();
+        drawCalls += game.getRenderQueue().getNumberOfDrawCalls();
+        stateChanges += game.getRenderQueue().getNumberOfStateChanges();
+    }
+
+    glCheckError();
+
+    if (frames > 0) {
+        std::cout << "INFO::HEADLESS " << frames << " frames at "
+                  << context.getWidth() << "x" << context.getHeight() << std::endl;
+        printTimings("Game::setUpShaders()", setUpShadersTimings);
+        printTimings("Game::draw()", drawTimings);
+        printTimings("Frame", frameTimings);
+        std::cout << "INFO::HEADLESS Terrain triangles avg " << terrainTriangles / frames
+                  << ", drawn chunks avg " << terrainChunks / frames
+                  << ", occluded chunks avg " << occludedChunks / frames
+                  << ", chunks at end " << game.getTerrain().getNumberOfChunks() << std::endl;
+        std::cout << "INFO::HEADLESS Visible objects avg " << visibleObjects / frames
+                  << " of " << game.getNumberOfObjects()
+                  << ", occluded avg " << occludedObjects / frames << std::endl;
+        std::cout << "INFO::HEADLESS Object draw calls avg " << drawCalls / frames
+                  << ", state changes avg " << stateChanges / frames << std::endl;
+        issuedGLCalls = GLStateCache::getNumberOfIssuedCalls() - issuedGLCalls;
+        skippedGLCalls = GLStateCache::getNumberOfSkippedCalls() - skippedGLCalls;
+        std::cout << "INFO::HEADLESS GL state calls avg " << issuedGLCalls / frames << " issued, "
+                  << skippedGLCalls / frames << " skipped" << std::endl;
+        std::cout << "INFO::HEADLESS Checksum of last frame " << std::hex
+                  << framebufferChecksum(context.getWidth(), context.getHeight())
+                  << std::dec << std::endl;
+    }
+
+    return 0;
+}
+
+// the whole text is a number within [minimum, maximum]
+bool parseNumber(const char *text, long long minimum, long long maximum, long long &value) {
+    char *end;
+    errno = 0;
+    value = std::strtoll(text, &end, 10);
+    return end != text && *end == '\0' && errno == 0 && value >= minimum && value <= maximum;
+}
+
+void printUsage(const char *program) {
+    std::cerr << "Usage: " << program
+              << " [--headless] [--frames N] [--record FILE] [--replay FILE] [--fixed-step]"
+              << " [--terrain-size N | --infinite | --map FILE] [--seed N] [--save-map FILE]"
+              << " [--no-shader-cache]" << std::endl;
+}
+
+int main(int argc, char *argv[]) {
+    bool headless = false;
+    int frames = -1;
+    GameSettings settings;
+    std::string recordPath;
+    std::string replayPath;
+    bool fixedStep = false;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string argument = argv[i];
+
+        if (argument == "--headless") {
+            headless = true;
+
+        } else if (argument == "--frames" && i + 1 < argc) {
+            long long value;
+            if (!parseNumber(argv[++i], 0, INT_MAX, value)) {
+                std::cerr << "ERROR::MAIN::INVALID_FRAMES " << argv[i] << std::endl;
+                return -1;
+            }
+            frames = value;
+
+        } else if (argument == "--terrain-size" && i + 1 < argc) {
+            long long value;
+            if (!parseNumber(argv[++i], 2, GameSettings::MAXIMUM_TERRAIN_SIZE, value)) {
+                std::cerr << "ERROR::MAIN::INVALID_TERRAIN_SIZE " << argv[i] << std::endl;
+                return -1;
+            }
+            settings.terrainSize = value;
+
+        } else if (argument == "--infinite") {
+            settings.terrainSize = GameSettings::INFINITE_TERRAIN;
+
+        } else if (argument == "--seed" && i + 1 < argc) {
+            long long value;
+            if (!parseNumber(argv[++i], 0, UINT32_MAX, value)) {
+                std::cerr << "ERROR::MAIN::INVALID_SEED " << argv[i] << std::endl;
+                return -1;
+            }
+            settings.seed = value;
+
+        } else if (argument == "--map" && i + 1 < argc) {
+            settings.mapPath = argv[++i];
+
+        } else if (argument == "--save-map" && i + 1 < argc) {
+            settings.saveMapPath = argv[++i];
+
+        } else if (argument == "--no-shader-cache") {
+            Shader::setCacheDirectory("");
+
+        } else if (argument == "--record" && i + 1 < argc) {
+            recordPath = argv[++i];
+
+        } else if (argument == "--replay" && i + 1 < argc) {
+            replayPath = argv[++i];
+
+        } else if (argument == "--fixed-step") {
+            fixedStep = true;
+
+        } else {
+            printUsage(argv[0]);
+            return -1;
+        }
+    }
+
+    // the number of frames only limits headless runs
+    if (frames >= 0 && !headless) {
+        printUsage(argv[0]);
+        return -1;
+    }
+
+    // only a generated finite terrain can be saved
+    if (!settings.saveMapPath.empty()
+        && (!settings.mapPath.empty() || settings.terrainSize == GameSettings::INFINITE_TERRAIN)) {
+        std::cerr << "ERROR::MAIN::SAVE_MAP_NEEDS_FINITE_TERRAIN" << std::endl;
+        return -1;
+    }
+
+    // a map that cannot be read is an error rather than a reason to generate another terrain
+    if (!settings.mapPath.empty()) {
+        HeightMapFile mapFile;
+        if (!mapFile.open(settings.mapPath)) {
+            return -1;
+        }
+    }
+
+    InputRecorder recorder;
+    if (!recordPath.empty() && (headless || !recorder.open(recordPath))) {
+        std::cerr << "ERROR::INPUT::RECORDING_NOT_POSSIBLE" << std::endl;
+        return -1;
+    }
+
+    InputReplay replay;
+    if (!replayPath.empty() && !replay.load(replayPath)) {
+        return -1;
+    }
+    // live input keeps the measured timestep
+    if (fixedStep) {
+        if (replayPath.empty()) {
+            printUsage(argv[0]);
+            return -1;
+        }
+        replay.setFixedTimestep(FIXED_TIMESTEP);
+    }
+
+    stbi_set_flip_vertically_on_load(true);
+
+    if (headless) {
+        return runHeadless(frames, settings, replay);
+    } else {
+        return runWindowed(settings, recorder, replay);
+    }
+}
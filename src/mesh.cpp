@@ -11,9 +11,23 @@ Mesh::Mesh(std::vector<Vertex> vertices,
     this->indices = indices;
     this->textures = textures;
 
+    computeBounds();
     setUpMesh();
 }
 
+void Mesh::computeBounds() {
+    if (vertices.empty()) {
+        boundsMinimum = boundsMaximum = glm::vec3(0.0f);
+        return;
+    }
+
+    boundsMinimum = boundsMaximum = vertices[0].position;
+    for (const Vertex &vertex : vertices) {
+        boundsMinimum = glm::min(boundsMinimum, vertex.position);
+        boundsMaximum = glm::max(boundsMaximum, vertex.position);
+    }
+}
+
 void Mesh::setUpMesh() {
     // generate object
     glGenVertexArrays(1, &VAO);
@@ -34,7 +48,27 @@ void Mesh::setUpMesh() {
     glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int),
                  &indices[0], GL_STATIC_DRAW);
     
-    
+    setUpVertexAttributes();
+
+    // number the textures of each type once instead of on every draw
+    unsigned int diffuseNumber = 1;
+    unsigned int specularNumber = 1;
+
+    samplerNames.clear();
+    for (const Texture &texture : textures) {
+        std::string textureNumber;
+
+        if (texture.type == "texture_diffuse") {
+            textureNumber = std::to_string(diffuseNumber++);
+        } else if (texture.type == "texture_specular") {
+            textureNumber = std::to_string(specularNumber++);
+        }
+
+        samplerNames.push_back("material." + texture.type + textureNumber);
+    }
+}
+
+void Mesh::setUpVertexAttributes() {
     // configure vertex attribute: vertex positions
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex),
                           (void*)0);
@@ -54,30 +88,50 @@ void Mesh::setUpMesh() {
     glEnableVertexAttribArray(2);
 }
 
-void Mesh::draw(Shader &shader) {
-    unsigned int diffuseNumber = 1;
-    unsigned int specularNumber = 1;
-    
-    shader.use();
+Instance Instance::fromModelMatrix(const glm::mat4 &model) {
+    Instance instance;
+    instance.modelView = Shader::getViewMatrix() * model;
+    instance.normalMatrix = glm::inverseTranspose(glm::mat3(instance.modelView));
+    return instance;
+}
+
+void Mesh::setUpInstanceAttributes(unsigned int instanceVBO) {
+    glBindVertexArray(VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+
+    // a matrix attribute takes one location per column
+    for (unsigned int i = 0; i < 4; ++i) {
+        glVertexAttribPointer(3 + i, 4, GL_FLOAT, GL_FALSE, sizeof(Instance),
+                              (void*)(offsetof(Instance, modelView) + i * sizeof(glm::vec4)));
+        glEnableVertexAttribArray(3 + i);
+        glVertexAttribDivisor(3 + i, 1);
+    }
+    for (unsigned int i = 0; i < 3; ++i) {
+        glVertexAttribPointer(7 + i, 3, GL_FLOAT, GL_FALSE, sizeof(Instance),
+                              (void*)(offsetof(Instance, normalMatrix) + i * sizeof(glm::vec3)));
+        glEnableVertexAttribArray(7 + i);
+        glVertexAttribDivisor(7 + i, 1);
+    }
+
+    glBindVertexArray(0);
+}
+
+void Mesh::bindTextures(Shader &shader) {
     for (unsigned int i = 0; i < textures.size(); ++i) {
         // activate texture unit
         glActiveTexture(GL_TEXTURE0 + i);
 
-        std::string textureNumber;
-        std::string textureType = textures[i].type;
-        
-        if (textureType == "texture_diffuse") {
-            textureNumber = std::to_string(diffuseNumber++);
-        } else if (textureType == "texture_specular") {
-            textureNumber = std::to_string(specularNumber++);
-        }
-
         // tell OpenGL that the sampler belongs to texture unit i
-        shader.setInt(("material." + textureType + textureNumber).c_str(), i);
+        shader.setInt(shader.getUniformLocation(samplerNames[i]), i);
 
         // bind texture to active texture unit
         glBindTexture(GL_TEXTURE_2D, textures[i].id);
     }
+}
+
+void Mesh::draw(Shader &shader) {
+    shader.use();
+    bindTextures(shader);
 
     // draw mesh
     glBindVertexArray(VAO);
@@ -87,6 +141,30 @@ void Mesh::draw(Shader &shader) {
     glBindVertexArray(0);
 }
 
+unsigned int Mesh::getVAO() const {
+    return VAO;
+}
+
+unsigned int Mesh::getNumberOfIndices() const {
+    return indices.size();
+}
+
+const std::vector<Texture>& Mesh::getTextures() const {
+    return textures;
+}
+
+const std::vector<std::string>& Mesh::getSamplerNames() const {
+    return samplerNames;
+}
+
+glm::vec3 Mesh::getBoundsMinimum() const {
+    return boundsMinimum;
+}
+
+glm::vec3 Mesh::getBoundsMaximum() const {
+    return boundsMaximum;
+}
+
 Mesh Mesh::fromAssimpMesh(aiMesh *mesh, const aiScene *scene, std::string &directory) {
     std::vector<Vertex> vertices;
     std::vector<unsigned int> indices;
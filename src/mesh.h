@@ -16,6 +16,16 @@ struct Vertex {
     glm::vec2 textureCoordinates;
 };
 
+// per-instance attributes of instanced draws, the same matrices that
+// Shader::setModelMatrix sets as uniforms for single draws
+struct Instance {
+    glm::mat4 modelView;
+    glm::mat3 normalMatrix;
+
+    // combine the model matrix with the current view matrix of Shader
+    static Instance fromModelMatrix(const glm::mat4 &model);
+};
+
 extern std::vector<Texture> loadedTextures;
 
 class Mesh {
@@ -23,10 +33,19 @@ private:
     std::vector<Vertex> vertices;
     std::vector<unsigned int> indices;
     std::vector<Texture> textures;
+    // names of the sampler uniforms the textures are bound to, "material.texture_diffuse1" etc.
+    std::vector<std::string> samplerNames;
 
     unsigned int VAO; // vertex attribute object
     unsigned int VBO; // vertex buffer object
     unsigned int EBO; // element buffer object
+
+    // bounding box in model space
+    glm::vec3 boundsMinimum;
+    glm::vec3 boundsMaximum;
+
+    void computeBounds();
+    void bindTextures(Shader &shader);
     
 public:
     Mesh(std::vector<Vertex> vertices,
@@ -34,8 +53,21 @@ public:
          std::vector<Texture> textures);
 
     void setUpMesh();
+    // configure the attributes of the Vertex layout for the bound VAO and VBO
+    static void setUpVertexAttributes();
+    // read the Instance attributes from the instance buffer, one per instance
+    void setUpInstanceAttributes(unsigned int instanceVBO);
     void draw(Shader &shader);
 
+    // what a draw of the mesh binds, for drawing without redundant binds (RenderQueue)
+    unsigned int getVAO() const;
+    unsigned int getNumberOfIndices() const;
+    const std::vector<Texture>& getTextures() const;
+    const std::vector<std::string>& getSamplerNames() const;
+
+    glm::vec3 getBoundsMinimum() const;
+    glm::vec3 getBoundsMaximum() const;
+
     static Mesh fromAssimpMesh(aiMesh *mesh, const aiScene *scene, std::string &directory);
     static std::vector<Texture> loadMaterialTextures(aiMaterial *material,
                                                            aiTextureType type,
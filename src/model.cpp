@@ -31,11 +31,15 @@ void Model::processScene(const aiScene *scene, std::string &directory) {
     }
 }
 
-Model::Model() {
+Model::Model()
+    : instanceVBO(0) {
+    computeBounds();
 }
 
-Model::Model(const Mesh &mesh) {
+Model::Model(const Mesh &mesh)
+    : instanceVBO(0) {
     meshes.push_back(mesh);
+    computeBounds();
 }
 
 void Model::loadModel(const std::string &path) {
@@ -50,6 +54,7 @@ void Model::loadModel(const std::string &path) {
     directory = path.substr(0, path.find_last_of('/'));
 
     processScene(scene, directory);
+    computeBounds();
 }
 
 void Model::draw(Shader &shader) {
@@ -57,3 +62,42 @@ void Model::draw(Shader &shader) {
         meshes[i].draw(shader);
     }
 }
+
+std::vector<Mesh>& Model::getMeshes() {
+    return meshes;
+}
+
+void Model::uploadInstances(const std::vector<Instance> &instances) {
+    if (instanceVBO == 0) {
+        glGenBuffers(1, &instanceVBO);
+        for (Mesh &mesh : meshes) {
+            mesh.setUpInstanceAttributes(instanceVBO);
+        }
+    }
+
+    // the instances change every frame, a new buffer store avoids waiting for the previous draws
+    glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+    glBufferData(GL_ARRAY_BUFFER, instances.size() * sizeof(Instance), instances.data(), GL_STREAM_DRAW);
+}
+
+void Model::computeBounds() {
+    boundsMinimum = boundsMaximum = glm::vec3(0.0f);
+    if (meshes.empty()) {
+        return;
+    }
+
+    boundsMinimum = meshes[0].getBoundsMinimum();
+    boundsMaximum = meshes[0].getBoundsMaximum();
+    for (const Mesh &mesh : meshes) {
+        boundsMinimum = glm::min(boundsMinimum, mesh.getBoundsMinimum());
+        boundsMaximum = glm::max(boundsMaximum, mesh.getBoundsMaximum());
+    }
+}
+
+glm::vec3 Model::getBoundsMinimum() const {
+    return boundsMinimum;
+}
+
+glm::vec3 Model::getBoundsMaximum() const {
+    return boundsMaximum;
+}
@@ -11,14 +11,28 @@ class Model {
 private:
     std::string directory;
     std::vector<Mesh> meshes;
+    // per-instance attributes of all meshes, created on the first instanced draw
+    unsigned int instanceVBO;
+    // bounding box of all meshes
+    glm::vec3 boundsMinimum;
+    glm::vec3 boundsMaximum;
 
     void processScene(const aiScene *scene, std::string &directory);
+    void computeBounds();
 
 public:
     Model();
     Model(const Mesh &mesh);
     void loadModel(const std::string &path);
     void draw(Shader &shader);
+
+    // bounding box of all meshes in model space
+    glm::vec3 getBoundsMinimum() const;
+    glm::vec3 getBoundsMaximum() const;
+
+    std::vector<Mesh>& getMeshes();
+    // replace the instances in the instance buffer that the meshes read when drawn instanced
+    void uploadInstances(const std::vector<Instance> &instances);
 };
 
 #endif
@@ -0,0 +1,245 @@
+#include "occlusion.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+static const float FAR_AWAY = std::numeric_limits<float>::infinity();
+
+// the box of pixels of the pyramid level that is tested is at most this large
+static const int MAXIMUM_TEST_SIZE = 4;
+
+OcclusionBuffer::OcclusionBuffer(int width, int height)
+    : width(width),
+      height(height),
+      projectionView(1.0f),
+      pyramidBuilt(false),
+      numberOfTriangles(0) {
+    depths.assign(width * height, FAR_AWAY);
+
+    // the size of the buffer is fixed, so the levels are allocated once and refilled every frame,
+    // every further level holds 2x2 texels of the level below
+    PyramidLevel level;
+    level.width = width;
+    level.height = height;
+    while (true) {
+        level.depths.resize(level.width * level.height);
+        pyramid.push_back(level);
+        if (level.width == 1 && level.height == 1) {
+            break;
+        }
+        level.width = (level.width + 1) / 2;
+        level.height = (level.height + 1) / 2;
+    }
+}
+
+void OcclusionBuffer::clear(const glm::mat4 &projectionView) {
+    this->projectionView = projectionView;
+    std::fill(depths.begin(), depths.end(), FAR_AWAY);
+    pyramidBuilt = false;
+    numberOfTriangles = 0;
+}
+
+// the part of the convex polygon with dot(plane, vertex) >= 0, which has at most one
+// vertex more than the polygon; returns the number of clipped vertices
+static int clipPolygon(const glm::vec4 &plane, const glm::vec4 *polygon, int numberOfVertices,
+                       glm::vec4 *clipped) {
+    int numberOfClipped = 0;
+    for (int i = 0; i < numberOfVertices; ++i) {
+        const glm::vec4 &current = polygon[i];
+        const glm::vec4 &next = polygon[(i + 1) % numberOfVertices];
+        float currentDistance = glm::dot(plane, current);
+        float nextDistance = glm::dot(plane, next);
+
+        if (currentDistance >= 0.0f) {
+            clipped[numberOfClipped++] = current;
+        }
+        if ((currentDistance >= 0.0f) != (nextDistance >= 0.0f)) {
+            float t = currentDistance / (currentDistance - nextDistance);
+            clipped[numberOfClipped++] = current + t * (next - current);
+        }
+    }
+    return numberOfClipped;
+}
+
+void OcclusionBuffer::drawTriangle(const glm::vec3 &a, const glm::vec3 &b, const glm::vec3 &c) {
+    glm::vec4 clipA = projectionView * glm::vec4(a, 1.0f);
+    glm::vec4 clipB = projectionView * glm::vec4(b, 1.0f);
+    glm::vec4 clipC = projectionView * glm::vec4(c, 1.0f);
+    ++numberOfTriangles;
+
+    // geometry before the near or beyond the far plane is not drawn, so it hides nothing
+    const glm::vec4 nearPlane(0.0f, 0.0f, 1.0f, 1.0f);
+    const glm::vec4 farPlane(0.0f, 0.0f, -1.0f, 1.0f);
+    bool inside = true;
+    for (const glm::vec4 &vertex : {clipA, clipB, clipC}) {
+        if (glm::dot(nearPlane, vertex) < 0.0f || glm::dot(farPlane, vertex) < 0.0f) {
+            inside = false;
+        }
+    }
+    if (inside) {
+        rasterizeTriangle(clipA, clipB, clipC);
+        return;
+    }
+
+    // the triangle becomes a polygon of at most five vertices after the two planes
+    glm::vec4 polygon[5] = {clipA, clipB, clipC};
+    glm::vec4 nearClipped[5];
+    int numberOfVertices = clipPolygon(nearPlane, polygon, 3, nearClipped);
+    numberOfVertices = clipPolygon(farPlane, nearClipped, numberOfVertices, polygon);
+    for (int i = 2; i < numberOfVertices; ++i) {
+        rasterizeTriangle(polygon[0], polygon[i - 1], polygon[i]);
+    }
+}
+
+void OcclusionBuffer::rasterizeTriangle(const glm::vec4 &a, const glm::vec4 &b, const glm::vec4 &c) {
+    // pixel coordinates, and 1 / depth that is linear on the screen
+    glm::vec3 screen[3];
+    const glm::vec4 *vertices[3] = {&a, &b, &c};
+    for (int i = 0; i < 3; ++i) {
+        const glm::vec4 &vertex = *vertices[i];
+        screen[i] = glm::vec3((vertex.x / vertex.w * 0.5f + 0.5f) * width,
+                              (vertex.y / vertex.w * 0.5f + 0.5f) * height,
+                              1.0f / vertex.w);
+    }
+
+    auto edge = [](const glm::vec3 &from, const glm::vec3 &to, float x, float y) {
+        return (to.x - from.x) * (y - from.y) - (to.y - from.y) * (x - from.x);
+    };
+
+    float area = edge(screen[0], screen[1], screen[2].x, screen[2].y);
+    if (area == 0.0f) {
+        return;
+    }
+    // both sides are drawn
+    if (area < 0.0f) {
+        std::swap(screen[1], screen[2]);
+        area = -area;
+    }
+
+    // pixels whose centers are within the bounds of the triangle
+    float minimumX = std::min(screen[0].x, std::min(screen[1].x, screen[2].x));
+    float maximumX = std::max(screen[0].x, std::max(screen[1].x, screen[2].x));
+    float minimumY = std::min(screen[0].y, std::min(screen[1].y, screen[2].y));
+    float maximumY = std::max(screen[0].y, std::max(screen[1].y, screen[2].y));
+    int firstX = std::max((int)std::ceil(minimumX - 0.5f), 0);
+    int lastX = std::min((int)std::floor(maximumX - 0.5f), width - 1);
+    int firstY = std::max((int)std::ceil(minimumY - 0.5f), 0);
+    int lastY = std::min((int)std::floor(maximumY - 0.5f), height - 1);
+
+    for (int y = firstY; y <= lastY; ++y) {
+        float centerY = y + 0.5f;
+        for (int x = firstX; x <= lastX; ++x) {
+            float centerX = x + 0.5f;
+            float weightA = edge(screen[1], screen[2], centerX, centerY);
+            float weightB = edge(screen[2], screen[0], centerX, centerY);
+            float weightC = edge(screen[0], screen[1], centerX, centerY);
+            if (weightA < 0.0f || weightB < 0.0f || weightC < 0.0f) {
+                continue;
+            }
+
+            float inverseDepth = (weightA * screen[0].z + weightB * screen[1].z + weightC * screen[2].z) / area;
+            float &depth = depths[y * width + x];
+            depth = std::min(depth, 1.0f / inverseDepth);
+        }
+    }
+}
+
+void OcclusionBuffer::buildPyramid() {
+    // the depths are only known at the centers of the pixels, the farthest depth of
+    // the neighbours also covers the rest of each pixel (and the pixels on the
+    // silhouette that are only partly covered)
+    PyramidLevel &base = pyramid[0];
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            float depth = 0.0f;
+            for (int neighbourY = std::max(y - 1, 0); neighbourY <= std::min(y + 1, height - 1); ++neighbourY) {
+                for (int neighbourX = std::max(x - 1, 0); neighbourX <= std::min(x + 1, width - 1); ++neighbourX) {
+                    depth = std::max(depth, depths[neighbourY * width + neighbourX]);
+                }
+            }
+            base.depths[y * width + x] = depth;
+        }
+    }
+
+    // every further level keeps the farthest depth of 2x2 texels of the level below
+    for (unsigned int i = 1; i < pyramid.size(); ++i) {
+        const PyramidLevel &below = pyramid[i - 1];
+        PyramidLevel &level = pyramid[i];
+        for (int y = 0; y < level.height; ++y) {
+            for (int x = 0; x < level.width; ++x) {
+                int belowX = std::min(2 * x + 1, below.width - 1);
+                int belowY = std::min(2 * y + 1, below.height - 1);
+                level.depths[y * level.width + x] = std::max(
+                    std::max(below.depths[2 * y * below.width + 2 * x], below.depths[2 * y * below.width + belowX]),
+                    std::max(below.depths[belowY * below.width + 2 * x], below.depths[belowY * below.width + belowX]));
+            }
+        }
+    }
+    pyramidBuilt = true;
+}
+
+bool OcclusionBuffer::isBoxOccluded(const glm::vec3 &minimum, const glm::vec3 &maximum) const {
+    if (!pyramidBuilt) {
+        return false;
+    }
+
+    // the nearest point of the box is one of its corners
+    float nearestDepth = FAR_AWAY;
+    float minimumX = FAR_AWAY;
+    float maximumX = -FAR_AWAY;
+    float minimumY = FAR_AWAY;
+    float maximumY = -FAR_AWAY;
+    for (int corner = 0; corner < 8; ++corner) {
+        glm::vec3 position((corner & 1) ? maximum.x : minimum.x,
+                           (corner & 2) ? maximum.y : minimum.y,
+                           (corner & 4) ? maximum.z : minimum.z);
+        glm::vec4 clip = projectionView * glm::vec4(position, 1.0f);
+
+        // boxes that reach before the near plane cover too much of the screen to be hidden
+        if (clip.z < -clip.w) {
+            return false;
+        }
+
+        float x = (clip.x / clip.w * 0.5f + 0.5f) * width;
+        float y = (clip.y / clip.w * 0.5f + 0.5f) * height;
+        nearestDepth = std::min(nearestDepth, clip.w);
+        minimumX = std::min(minimumX, x);
+        maximumX = std::max(maximumX, x);
+        minimumY = std::min(minimumY, y);
+        maximumY = std::max(maximumY, y);
+    }
+
+    if (maximumX < 0.0f || minimumX >= width || maximumY < 0.0f || minimumY >= height) {
+        return false;
+    }
+    int firstX = std::max((int)std::floor(minimumX), 0);
+    int lastX = std::min((int)std::floor(maximumX), width - 1);
+    int firstY = std::max((int)std::floor(minimumY), 0);
+    int lastY = std::min((int)std::floor(maximumY), height - 1);
+
+    // the finest level at which the box covers only a few texels
+    unsigned int level = 0;
+    while ((lastX - firstX >= MAXIMUM_TEST_SIZE || lastY - firstY >= MAXIMUM_TEST_SIZE)
+           && level + 1 < pyramid.size()) {
+        firstX /= 2;
+        lastX /= 2;
+        firstY /= 2;
+        lastY /= 2;
+        ++level;
+    }
+
+    const PyramidLevel &texels = pyramid[level];
+    for (int y = firstY; y <= lastY; ++y) {
+        for (int x = firstX; x <= lastX; ++x) {
+            if (texels.depths[y * texels.width + x] >= nearestDepth) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+unsigned int OcclusionBuffer::getNumberOfTriangles() const {
+    return numberOfTriangles;
+}
@@ -0,0 +1,58 @@
+#ifndef OCCLUSION_H
+#define OCCLUSION_H
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+// low resolution depth buffer that occluders are rasterized into on the CPU, with a
+// hierarchical-Z pyramid of the farthest depth for testing bounding boxes against it;
+// occluders have to lie behind the geometry that is actually drawn, then a box that is
+// reported as occluded is hidden on screen as well
+class OcclusionBuffer {
+public:
+    static const int DEFAULT_WIDTH = 256;
+    static const int DEFAULT_HEIGHT = 144;
+
+private:
+    struct PyramidLevel {
+        int width;
+        int height;
+        // farthest view space depth within each texel, infinity where nothing was drawn
+        std::vector<float> depths;
+    };
+
+    int width;
+    int height;
+    glm::mat4 projectionView;
+
+    // view space depth (distance along the view direction) of the nearest occluder
+    // at the center of each pixel
+    std::vector<float> depths;
+    std::vector<PyramidLevel> pyramid;
+    // false from clear until buildPyramid
+    bool pyramidBuilt;
+
+    unsigned int numberOfTriangles;
+
+    // triangle in clip space that is in front of the near plane
+    void rasterizeTriangle(const glm::vec4 &a, const glm::vec4 &b, const glm::vec4 &c);
+
+public:
+    OcclusionBuffer(int width = DEFAULT_WIDTH, int height = DEFAULT_HEIGHT);
+
+    // remove all occluders and start a frame seen through the projection * view matrix
+    void clear(const glm::mat4 &projectionView);
+    // world space triangle, both sides occlude
+    void drawTriangle(const glm::vec3 &a, const glm::vec3 &b, const glm::vec3 &c);
+    // once all occluders are drawn
+    void buildPyramid();
+
+    // true only if the whole box is behind the occluders
+    bool isBoxOccluded(const glm::vec3 &minimum, const glm::vec3 &maximum) const;
+
+    // occluder triangles since the last clear
+    unsigned int getNumberOfTriangles() const;
+};
+
+#endif
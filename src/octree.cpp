@@ -0,0 +1,279 @@
+#include "octree.h"
+
+#include <algorithm>
+
+Octree::Octree(const glm::vec3 &center, float halfSize) {
+    root = createNode(center, std::max(halfSize, MINIMUM_HALF_SIZE), -1);
+}
+
+int Octree::createNode(const glm::vec3 &center, float halfSize, int parent) {
+    Node node;
+    node.center = center;
+    node.halfSize = halfSize;
+    node.parent = parent;
+    std::fill(node.children, node.children + 8, -1);
+    node.numberOfItems = 0;
+
+    nodes.push_back(node);
+    return nodes.size() - 1;
+}
+
+bool Octree::fits(int node, const glm::vec3 &center, float radius) const {
+    const Node &cell = nodes[node];
+    glm::vec3 offset = glm::abs(center - cell.center);
+    return offset.x <= cell.halfSize && offset.y <= cell.halfSize && offset.z <= cell.halfSize
+        && radius <= cell.halfSize;
+}
+
+int Octree::getChildIndex(int node, const glm::vec3 &point) const {
+    const glm::vec3 &center = nodes[node].center;
+    return (point.x >= center.x ? 1 : 0) | (point.y >= center.y ? 2 : 0) | (point.z >= center.z ? 4 : 0);
+}
+
+void Octree::getLooseBounds(int node, glm::vec3 &minimum, glm::vec3 &maximum) const {
+    glm::vec3 extent(2.0f * nodes[node].halfSize);
+    minimum = nodes[node].center - extent;
+    maximum = nodes[node].center + extent;
+}
+
+void Octree::grow(const glm::vec3 &point) {
+    // the old root becomes the child of the new one that lies away from the point
+    glm::vec3 oldCenter = nodes[root].center;
+    float oldHalfSize = nodes[root].halfSize;
+    glm::vec3 direction(point.x >= oldCenter.x ? 1.0f : -1.0f,
+                        point.y >= oldCenter.y ? 1.0f : -1.0f,
+                        point.z >= oldCenter.z ? 1.0f : -1.0f);
+
+    int newRoot = createNode(oldCenter + direction * oldHalfSize, 2.0f * oldHalfSize, -1);
+    nodes[newRoot].children[getChildIndex(newRoot, oldCenter)] = root;
+    nodes[newRoot].numberOfItems = nodes[root].numberOfItems;
+    nodes[root].parent = newRoot;
+    root = newRoot;
+}
+
+int Octree::findNode(const glm::vec3 &minimum, const glm::vec3 &maximum) {
+    glm::vec3 center = (minimum + maximum) * 0.5f;
+    glm::vec3 extent = (maximum - minimum) * 0.5f;
+    float radius = std::max(extent.x, std::max(extent.y, extent.z));
+
+    while (!fits(root, center, radius) && nodes[root].halfSize < MAXIMUM_HALF_SIZE) {
+        grow(center);
+    }
+    if (!fits(root, center, radius)) {
+        return root;
+    }
+
+    // the smallest cell that still holds the box
+    int node = root;
+    while (true) {
+        float childHalfSize = nodes[node].halfSize * 0.5f;
+        if (childHalfSize < MINIMUM_HALF_SIZE || radius > childHalfSize) {
+            return node;
+        }
+
+        int index = getChildIndex(node, center);
+        if (nodes[node].children[index] < 0) {
+            glm::vec3 offset((index & 1) ? childHalfSize : -childHalfSize,
+                             (index & 2) ? childHalfSize : -childHalfSize,
+                             (index & 4) ? childHalfSize : -childHalfSize);
+            int child = createNode(nodes[node].center + offset, childHalfSize, node);
+            nodes[node].children[index] = child;
+        }
+        node = nodes[node].children[index];
+    }
+}
+
+void Octree::addToNode(unsigned int id, int node) {
+    items[id].node = node;
+    items[id].index = nodes[node].items.size();
+    nodes[node].items.push_back(id);
+
+    for (int parent = node; parent >= 0; parent = nodes[parent].parent) {
+        ++nodes[parent].numberOfItems;
+    }
+}
+
+void Octree::removeFromNode(unsigned int id) {
+    Item &item = items[id];
+    std::vector<unsigned int> &nodeItems = nodes[item.node].items;
+
+    // the last item of the node takes the place of the removed one
+    unsigned int last = nodeItems.back();
+    nodeItems[item.index] = last;
+    items[last].index = item.index;
+    nodeItems.pop_back();
+
+    for (int parent = item.node; parent >= 0; parent = nodes[parent].parent) {
+        --nodes[parent].numberOfItems;
+    }
+    item.node = -1;
+}
+
+void Octree::insert(unsigned int id, const glm::vec3 &minimum, const glm::vec3 &maximum) {
+    if (id >= items.size()) {
+        items.resize(id + 1, {glm::vec3(0.0f), glm::vec3(0.0f), -1, 0});
+    }
+    if (items[id].node >= 0) {
+        update(id, minimum, maximum);
+        return;
+    }
+
+    items[id].minimum = minimum;
+    items[id].maximum = maximum;
+    addToNode(id, findNode(minimum, maximum));
+}
+
+void Octree::update(unsigned int id, const glm::vec3 &minimum, const glm::vec3 &maximum) {
+    if (id >= items.size() || items[id].node < 0) {
+        insert(id, minimum, maximum);
+        return;
+    }
+
+    Item &item = items[id];
+    item.minimum = minimum;
+    item.maximum = maximum;
+
+    // the item stays where it is as long as its node still holds it
+    glm::vec3 center = (minimum + maximum) * 0.5f;
+    glm::vec3 extent = (maximum - minimum) * 0.5f;
+    float radius = std::max(extent.x, std::max(extent.y, extent.z));
+    if (fits(item.node, center, radius)) {
+        return;
+    }
+
+    removeFromNode(id);
+    addToNode(id, findNode(minimum, maximum));
+}
+
+void Octree::remove(unsigned int id) {
+    if (id < items.size() && items[id].node >= 0) {
+        removeFromNode(id);
+    }
+}
+
+void Octree::collectItems(int node, std::vector<unsigned int> &result) const {
+    const Node &cell = nodes[node];
+    if (cell.numberOfItems == 0) {
+        return;
+    }
+
+    result.insert(result.end(), cell.items.begin(), cell.items.end());
+    for (int child : cell.children) {
+        if (child >= 0) {
+            collectItems(child, result);
+        }
+    }
+}
+
+void Octree::collectFrustum(int node, const Frustum &frustum, std::vector<unsigned int> &result) {
+    if (nodes[node].numberOfItems == 0) {
+        return;
+    }
+
+    // the root also holds the items that do not fit into it
+    if (node != root) {
+        glm::vec3 minimum;
+        glm::vec3 maximum;
+        getLooseBounds(node, minimum, maximum);
+        if (!frustum.isBoxVisible(minimum, maximum)) {
+            return;
+        }
+        if (frustum.isBoxInside(minimum, maximum)) {
+            collectItems(node, result);
+            return;
+        }
+    }
+
+    const Node &cell = nodes[node];
+    candidates.insert(candidates.end(), cell.items.begin(), cell.items.end());
+    for (int child : cell.children) {
+        if (child >= 0) {
+            collectFrustum(child, frustum, result);
+        }
+    }
+}
+
+void Octree::queryFrustum(const Frustum &frustum, std::vector<unsigned int> &result) {
+    result.clear();
+    candidates.clear();
+    collectFrustum(root, frustum, result);
+
+    // the items of nodes on the border of the frustum are tested several at a time
+    candidateBounds.resize(candidates.size());
+    for (unsigned int i = 0; i < candidates.size(); ++i) {
+        const Item &item = items[candidates[i]];
+        candidateBounds.set(i, item.minimum, item.maximum);
+    }
+    frustum.testBoxes(candidateBounds, candidateVisible);
+
+    for (unsigned int i = 0; i < candidates.size(); ++i) {
+        if (candidateVisible[i]) {
+            result.push_back(candidates[i]);
+        }
+    }
+}
+
+// distance at which the ray enters the box (0 if it starts inside), false if it misses
+// the box or enters it beyond the maximum distance
+static bool intersectRay(const glm::vec3 &origin, const glm::vec3 &inverseDirection,
+                         const glm::vec3 &minimum, const glm::vec3 &maximum,
+                         float maxDistance, float &entry) {
+    glm::vec3 toMinimum = (minimum - origin) * inverseDirection;
+    glm::vec3 toMaximum = (maximum - origin) * inverseDirection;
+    glm::vec3 nearest = glm::min(toMinimum, toMaximum);
+    glm::vec3 farthest = glm::max(toMinimum, toMaximum);
+
+    entry = std::max(std::max(nearest.x, nearest.y), std::max(nearest.z, 0.0f));
+    float exit = std::min(std::min(farthest.x, farthest.y), std::min(farthest.z, maxDistance));
+    return entry <= exit;
+}
+
+void Octree::raycast(int node, const glm::vec3 &origin, const glm::vec3 &inverseDirection,
+                     float &distance, int &nearest) const {
+    const Node &cell = nodes[node];
+    if (cell.numberOfItems == 0) {
+        return;
+    }
+
+    float entry;
+    if (node != root) {
+        glm::vec3 minimum;
+        glm::vec3 maximum;
+        getLooseBounds(node, minimum, maximum);
+        // nodes behind the nearest hit so far cannot hold a nearer one
+        if (!intersectRay(origin, inverseDirection, minimum, maximum, distance, entry)) {
+            return;
+        }
+    }
+
+    for (unsigned int id : cell.items) {
+        if (intersectRay(origin, inverseDirection, items[id].minimum, items[id].maximum, distance, entry)
+            && (nearest < 0 || entry < distance)) {
+            distance = entry;
+            nearest = id;
+        }
+    }
+    for (int child : cell.children) {
+        if (child >= 0) {
+            raycast(child, origin, inverseDirection, distance, nearest);
+        }
+    }
+}
+
+int Octree::raycast(const glm::vec3 &origin, const glm::vec3 &direction, float &distance) const {
+    // division by zero gives infinity, which the slab test handles
+    glm::vec3 inverseDirection = 1.0f / direction;
+
+    int nearest = -1;
+    raycast(root, origin, inverseDirection, distance, nearest);
+    return nearest;
+}
+
+void Octree::getBounds(unsigned int id, glm::vec3 &minimum, glm::vec3 &maximum) const {
+    minimum = items[id].minimum;
+    maximum = items[id].maximum;
+}
+
+unsigned int Octree::getNumberOfNodes() const {
+    return nodes.size();
+}
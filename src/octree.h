@@ -0,0 +1,88 @@
+#ifndef OCTREE_H
+#define OCTREE_H
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "frustum.h"
+
+// loose octree over the bounding boxes of items that are identified by small integers;
+// every node holds the boxes whose center lies in its cell and that are not larger than
+// the cell, so its loose bounds are twice the size of the cell and an item only moves
+// to another node when its center leaves the cell
+class Octree {
+public:
+    // cells are not split below this half size
+    static constexpr float MINIMUM_HALF_SIZE = 8.0f;
+    // the root grows towards items outside of it up to this half size,
+    // items that still do not fit are kept in the root
+    static constexpr float MAXIMUM_HALF_SIZE = 524288.0f;
+
+private:
+    struct Node {
+        glm::vec3 center;
+        // half of the edge length of the cell
+        float halfSize;
+        int parent;
+        int children[8];
+        // items of this node and all nodes below it, empty subtrees are skipped by queries
+        unsigned int numberOfItems;
+        std::vector<unsigned int> items;
+    };
+
+    struct Item {
+        glm::vec3 minimum;
+        glm::vec3 maximum;
+        // -1 if the item is not in the tree
+        int node;
+        // position in the items of the node
+        unsigned int index;
+    };
+
+    // nodes are never freed, so that moving items do not create and delete them all the time
+    std::vector<Node> nodes;
+    int root;
+    std::vector<Item> items;
+
+    // candidates of a frustum query, tested together
+    std::vector<unsigned int> candidates;
+    BoundingBoxes candidateBounds;
+    std::vector<unsigned char> candidateVisible;
+
+    int createNode(const glm::vec3 &center, float halfSize, int parent);
+    bool fits(int node, const glm::vec3 &center, float radius) const;
+    int getChildIndex(int node, const glm::vec3 &point) const;
+    void getLooseBounds(int node, glm::vec3 &minimum, glm::vec3 &maximum) const;
+    // double the size of the root towards the point
+    void grow(const glm::vec3 &point);
+    int findNode(const glm::vec3 &minimum, const glm::vec3 &maximum);
+    void addToNode(unsigned int id, int node);
+    void removeFromNode(unsigned int id);
+
+    void collectItems(int node, std::vector<unsigned int> &result) const;
+    void collectFrustum(int node, const Frustum &frustum, std::vector<unsigned int> &result);
+    void raycast(int node, const glm::vec3 &origin, const glm::vec3 &inverseDirection,
+                 float &distance, int &nearest) const;
+
+public:
+    // the root cell, it grows when items are inserted outside of it
+    Octree(const glm::vec3 &center = glm::vec3(0.0f), float halfSize = 128.0f);
+
+    void insert(unsigned int id, const glm::vec3 &minimum, const glm::vec3 &maximum);
+    // new bounds of an item that has moved
+    void update(unsigned int id, const glm::vec3 &minimum, const glm::vec3 &maximum);
+    void remove(unsigned int id);
+
+    // items whose boxes intersect the frustum (or cross its planes near the corners),
+    // in no particular order
+    void queryFrustum(const Frustum &frustum, std::vector<unsigned int> &result);
+    // item with the nearest box along the normalized direction within the distance,
+    // -1 if there is none; the distance is set to the one of the hit
+    int raycast(const glm::vec3 &origin, const glm::vec3 &direction, float &distance) const;
+
+    void getBounds(unsigned int id, glm::vec3 &minimum, glm::vec3 &maximum) const;
+    unsigned int getNumberOfNodes() const;
+};
+
+#endif
@@ -0,0 +1,148 @@
+#include "renderqueue.h"
+
+#include <algorithm>
+#include <limits>
+
+#include <glad/glad.h>
+
+RenderQueue::RenderQueue()
+    : numberOfDrawCalls(0),
+      numberOfStateChanges(0) {
+}
+
+uint64_t RenderQueue::makeKey(unsigned int pass, unsigned int program, unsigned int texture,
+                              unsigned int VAO, float depth) {
+    // front to back within the same state, so that the depth test rejects more fragments
+    float clampedDepth = std::min(std::max(depth / MAX_DEPTH, 0.0f), 1.0f);
+    uint64_t depthBits = (uint64_t)(clampedDepth * 0xffff);
+
+    return ((uint64_t)(pass & 0xf) << 60)
+         | ((uint64_t)(program & 0xfff) << 48)
+         | ((uint64_t)(texture & 0xffff) << 32)
+         | ((uint64_t)(VAO & 0xffff) << 16)
+         | depthBits;
+}
+
+void RenderQueue::add(unsigned int pass, Model *model, Shader *shader, const glm::mat4 &modelMatrix) {
+    auto entry = batchIndices.find(std::make_tuple(pass, model, shader));
+    if (entry == batchIndices.end()) {
+        entry = batchIndices.emplace(std::make_tuple(pass, model, shader), batches.size()).first;
+        batches.push_back({pass, model, shader, nullptr, nullptr, {}, 0.0f});
+    }
+
+    Batch &batch = batches[entry->second];
+    if (batch.baseVariant != shader->getCurrentVariant()) {
+        batch.variant = shader->getVariant("INSTANCED");
+        batch.baseVariant = shader->getCurrentVariant();
+    }
+
+    Instance instance = Instance::fromModelMatrix(modelMatrix);
+    // the camera looks along -z in view space
+    float depth = -instance.modelView[3][2];
+    batch.depth = batch.instances.empty() ? depth : std::min(batch.depth, depth);
+    batch.instances.push_back(instance);
+}
+
+void RenderQueue::submit(const PassSetup &setUpPass) {
+    packets.clear();
+    for (unsigned int i = 0; i < batches.size(); ++i) {
+        const Batch &batch = batches[i];
+        if (batch.instances.empty()) {
+            continue;
+        }
+
+        for (Mesh &mesh : batch.model->getMeshes()) {
+            const std::vector<Texture> &textures = mesh.getTextures();
+            unsigned int texture = textures.empty() ? 0 : textures[0].id;
+            uint64_t key = makeKey(batch.pass, batch.variant->programID, texture, mesh.getVAO(), batch.depth);
+            packets.push_back({key, i, &mesh});
+        }
+    }
+
+    // equal keys keep the order of the batches, so that every run draws in the same order
+    std::stable_sort(packets.begin(), packets.end(), [](const DrawPacket &a, const DrawPacket &b) {
+        return a.key < b.key;
+    });
+
+    numberOfDrawCalls = 0;
+    numberOfStateChanges = 0;
+
+    unsigned int currentPass = MAX_PASSES;
+    const Shader::Variant *currentVariant = nullptr;
+    unsigned int currentVAO = 0;
+    const std::vector<std::string> *currentSamplerNames = nullptr;
+    std::vector<unsigned int> boundTextures;
+    // batches of the same model share its instance buffer
+    std::map<Model*, unsigned int> uploadedBatches;
+
+    for (const DrawPacket &packet : packets) {
+        Batch &batch = batches[packet.batch];
+        Mesh &mesh = *packet.mesh;
+
+        if (batch.pass != currentPass) {
+            setUpPass(batch.pass);
+            currentPass = batch.pass;
+        }
+
+        if (batch.variant != currentVariant) {
+            batch.shader->use(*batch.variant);
+            ++numberOfStateChanges;
+
+            currentVariant = batch.variant;
+            currentSamplerNames = nullptr;
+        }
+
+        // samplers only have to be set when the program or the kind of textures change
+        const std::vector<Texture> &textures = mesh.getTextures();
+        const std::vector<std::string> &samplerNames = mesh.getSamplerNames();
+        if (!currentSamplerNames || *currentSamplerNames != samplerNames) {
+            for (unsigned int i = 0; i < samplerNames.size(); ++i) {
+                batch.shader->setInt(batch.shader->getUniformLocation(*currentVariant, samplerNames[i]), i);
+            }
+            currentSamplerNames = &samplerNames;
+        }
+
+        if (boundTextures.size() < textures.size()) {
+            boundTextures.resize(textures.size(), 0);
+        }
+        for (unsigned int i = 0; i < textures.size(); ++i) {
+            if (boundTextures[i] != textures[i].id) {
+                glActiveTexture(GL_TEXTURE0 + i);
+                glBindTexture(GL_TEXTURE_2D, textures[i].id);
+                boundTextures[i] = textures[i].id;
+                ++numberOfStateChanges;
+            }
+        }
+
+        auto uploaded = uploadedBatches.find(batch.model);
+        if (uploaded == uploadedBatches.end() || uploaded->second != packet.batch) {
+            batch.model->uploadInstances(batch.instances);
+            uploadedBatches[batch.model] = packet.batch;
+        }
+
+        if (mesh.getVAO() != currentVAO) {
+            glBindVertexArray(mesh.getVAO());
+            currentVAO = mesh.getVAO();
+            ++numberOfStateChanges;
+        }
+
+        glDrawElementsInstanced(GL_TRIANGLES, mesh.getNumberOfIndices(), GL_UNSIGNED_INT, 0,
+                                batch.instances.size());
+        ++numberOfDrawCalls;
+    }
+
+    glBindVertexArray(0);
+
+    // keep the memory for the next frame
+    for (Batch &batch : batches) {
+        batch.instances.clear();
+    }
+}
+
+unsigned int RenderQueue::getNumberOfDrawCalls() const {
+    return numberOfDrawCalls;
+}
+
+unsigned int RenderQueue::getNumberOfStateChanges() const {
+    return numberOfStateChanges;
+}
@@ -0,0 +1,76 @@
+#ifndef RENDERQUEUE_H
+#define RENDERQUEUE_H
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <tuple>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "mesh.h"
+#include "model.h"
+#include "shader.h"
+
+// sets up the GL state of a pass (stencil test etc.) before its first draw
+typedef std::function<void(unsigned int pass)> PassSetup;
+
+// collects the objects of a frame and draws them sorted by pass, program, textures, VAO
+// and depth, so that state is only bound when it changes; objects with the same model and
+// shader in the same pass are drawn as instances of one draw call per mesh
+class RenderQueue {
+public:
+    static const unsigned int MAX_PASSES = 16;
+    // view space depth that is mapped to the farthest depth of the sort key
+    static constexpr float MAX_DEPTH = 300.0f;
+
+private:
+    struct Batch {
+        unsigned int pass;
+        Model *model;
+        Shader *shader;
+        // INSTANCED variant of the shader, looked up again when the current variant
+        // it was derived from changes (setDefine)
+        Shader::Variant *variant;
+        const Shader::Variant *baseVariant;
+        std::vector<Instance> instances;
+        // view space depth of the nearest instance
+        float depth;
+    };
+
+    // one draw call of a mesh of a batch
+    struct DrawPacket {
+        uint64_t key;
+        unsigned int batch;
+        Mesh *mesh;
+    };
+
+    // batches are kept over frames and only emptied, in the order they were first used
+    std::vector<Batch> batches;
+    std::map<std::tuple<unsigned int, Model*, Shader*>, unsigned int> batchIndices;
+    std::vector<DrawPacket> packets;
+
+    // counted during the last submit
+    unsigned int numberOfDrawCalls;
+    unsigned int numberOfStateChanges;
+
+    // pass (4 bits), program (12), first texture (16), VAO (16) and depth (16),
+    // IDs that do not fit only make the sorting less effective
+    static uint64_t makeKey(unsigned int pass, unsigned int program, unsigned int texture,
+                            unsigned int VAO, float depth);
+
+public:
+    RenderQueue();
+
+    // draw the model with the shader in the given pass, passes are drawn in ascending order
+    void add(unsigned int pass, Model *model, Shader *shader, const glm::mat4 &modelMatrix);
+    // draw everything added since the last submit
+    void submit(const PassSetup &setUpPass);
+
+    unsigned int getNumberOfDrawCalls() const;
+    // program, texture and VAO binds of the last submit
+    unsigned int getNumberOfStateChanges() const;
+};
+
+#endif
@@ -1,114 +1,783 @@
 #include "shader.h"
 
-Shader::Shader(const char *vertexPath, const char *fragmentPath) {
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// program binary files: magic, binary format and the binary as returned by the driver,
+// they are only read on the machine that wrote them
+static const char PROGRAM_BINARY_MAGIC[4] = {'O', 'G', 'L', 'S'};
+
+const char *Shader::DEFAULT_CACHE_DIRECTORY = "shadercache";
+std::string Shader::cacheDirectory = Shader::DEFAULT_CACHE_DIRECTORY;
+
+glm::mat4 Shader::viewMatrix = glm::mat4(1.0f);
+
+std::vector<Shader*> Shader::shaders;
+int Shader::inotifyDescriptor = -1;
+std::map<int, std::string> Shader::watchedDirectories;
+
+// includes within includes are followed up to this depth
+static const int MAX_INCLUDE_DEPTH = 8;
+
+Shader::Shader(const char *vertexPath, const char *fragmentPath, const std::vector<std::string> &defines)
+    : vertexPath(vertexPath),
+      fragmentPath(fragmentPath),
+      defines(defines),
+      variant(nullptr),
+      reloading(false) {
     // read shader sources from file
-    // vertex shader
-    std::string vertexSource;
-    std::ifstream vertexSourceFile;
-    vertexSourceFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+    readSources(vertexSource, fragmentSource);
 
-    try {
-        vertexSourceFile.open(vertexPath);
-        std::stringstream vertexSourceStream;
-        vertexSourceStream <<  vertexSourceFile.rdbuf();
-        vertexSourceFile.close();
-        vertexSource = vertexSourceStream.str();
-    } catch (std::ifstream::failure &e) {
-        std::cerr << "ERROR::SHADER::VERTEX::FILE_NOT_SUCCESSFULLY_READ" << std::endl;
+    std::sort(this->defines.begin(), this->defines.end());
+    variant = &findVariant(this->defines);
+
+    shaders.push_back(this);
+    watchSourceDirectories();
+}
+
+Shader::~Shader() {
+    shaders.erase(std::find(shaders.begin(), shaders.end(), this));
+
+    discardReload();
+    for (auto &entry : variants) {
+        glDeleteProgram(entry.second.programID);
     }
+}
 
-    const char *vertexSourceC = vertexSource.c_str();
+void Shader::readSources(std::string &newVertexSource, std::string &newFragmentSource) {
+    std::vector<std::string> vertexFiles;
+    std::vector<std::string> fragmentFiles;
+    newVertexSource = readSourceFile(vertexPath, 0, vertexFiles);
+    newFragmentSource = readSourceFile(fragmentPath, 0, fragmentFiles);
 
-    // fragment shader
-    std::string fragmentSource;
-    std::ifstream fragmentSourceFile;
-    fragmentSourceFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+    sourceFiles = vertexFiles;
+    sourceFiles.insert(sourceFiles.end(), fragmentFiles.begin(), fragmentFiles.end());
+    std::sort(sourceFiles.begin(), sourceFiles.end());
+    sourceFiles.erase(std::unique(sourceFiles.begin(), sourceFiles.end()), sourceFiles.end());
+}
+
+std::string Shader::readSourceFile(const std::string &path, int depth, std::vector<std::string> &files) {
+    int sourceNumber = files.size();
+    files.push_back(path);
+
+    std::string source;
+    std::ifstream sourceFile;
+    sourceFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
 
     try {
-        fragmentSourceFile.open(fragmentPath);
-        std::stringstream fragmentSourceStream;
-        fragmentSourceStream <<  fragmentSourceFile.rdbuf();
-        fragmentSourceFile.close();
-        fragmentSource = fragmentSourceStream.str();
+        sourceFile.open(path);
+        std::stringstream sourceStream;
+        sourceStream << sourceFile.rdbuf();
+        sourceFile.close();
+        source = sourceStream.str();
     } catch (std::ifstream::failure &e) {
-        std::cerr << "ERROR::SHADER::FRAGMENT::FILE_NOT_SUCCESSFULLY_READ" << std::endl;
+        std::cerr << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ " << path << std::endl;
+        return "";
+    }
+
+    // replace #include "file" by the file (relative to this one), #line directives keep the
+    // line numbers of compiler errors right, the source string number counts the files read
+    std::string directory = path.substr(0, path.find_last_of('/') + 1);
+    std::istringstream lines(source);
+    std::string result;
+    std::string line;
+
+    for (int lineNumber = 1; std::getline(lines, line); ++lineNumber) {
+        size_t start = line.find_first_not_of(" \t");
+        if (start == std::string::npos || line.compare(start, 8, "#include") != 0) {
+            result += line + "\n";
+            continue;
+        }
+
+        size_t nameStart = line.find('"', start);
+        size_t nameEnd = (nameStart == std::string::npos) ? nameStart : line.find('"', nameStart + 1);
+        if (nameEnd == std::string::npos || depth >= MAX_INCLUDE_DEPTH) {
+            std::cerr << "ERROR::SHADER::INVALID_INCLUDE " << path << ":" << lineNumber << std::endl;
+            result += "\n";
+            continue;
+        }
+
+        std::string includePath = directory + line.substr(nameStart + 1, nameEnd - nameStart - 1);
+        result += "#line 1 " + std::to_string(files.size()) + "\n";
+        result += readSourceFile(includePath, depth + 1, files);
+        result += "#line " + std::to_string(lineNumber + 1) + " " + std::to_string(sourceNumber) + "\n";
+    }
+
+    return result;
+}
+
+std::string Shader::addDefines(const std::string &source, const std::vector<std::string> &defines) {
+    std::string defineLines;
+    for (const std::string &define : defines) {
+        defineLines += "#define " + define + "\n";
+    }
+
+    // #version has to stay the first line
+    if (source.compare(0, 8, "#version") == 0) {
+        size_t lineEnd = source.find('\n');
+        if (lineEnd == std::string::npos) {
+            return source + "\n" + defineLines;
+        }
+        return source.substr(0, lineEnd + 1) + defineLines + "#line 2 0\n" + source.substr(lineEnd + 1);
+    }
+    return defineLines + "#line 1 0\n" + source;
+}
+
+std::vector<std::string> Shader::changeDefine(const std::string &name, bool enabled) const {
+    std::vector<std::string> newDefines;
+    for (const std::string &define : defines) {
+        if (define != name && define.compare(0, name.size() + 1, name + " ") != 0) {
+            newDefines.push_back(define);
+        }
+    }
+    if (enabled) {
+        newDefines.push_back(name);
+        std::sort(newDefines.begin(), newDefines.end());
+    }
+    return newDefines;
+}
+
+void Shader::setDefine(const std::string &name, bool enabled) {
+    std::vector<std::string> newDefines = changeDefine(name, enabled);
+    if (newDefines != defines) {
+        defines = newDefines;
+        variant = &findVariant(defines);
+    }
+}
+
+unsigned int Shader::getNumberOfVariants() const {
+    return variants.size();
+}
+
+Shader::Variant* Shader::getVariant(const std::string &define) {
+    return &findVariant(changeDefine(define, true));
+}
+
+const Shader::Variant* Shader::getCurrentVariant() const {
+    return variant;
+}
+
+Shader::Variant& Shader::findVariant(const std::vector<std::string> &variantDefines) {
+    auto entry = variants.find(variantDefines);
+    if (entry != variants.end()) {
+        return entry->second;
+    }
+
+    Variant &newVariant = variants[variantDefines];
+    std::string variantVertexSource = addDefines(vertexSource, variantDefines);
+    std::string variantFragmentSource = addDefines(fragmentSource, variantDefines);
+
+    std::string binaryPath = getProgramBinaryPath(variantVertexSource, variantFragmentSource);
+    if (!loadProgramBinary(newVariant, binaryPath)) {
+        PendingProgram program = startProgram(variantVertexSource, variantFragmentSource);
+        finishProgram(program);
+        newVariant.programID = program.programID;
+        saveProgramBinary(newVariant, binaryPath);
+    }
+
+    findUniforms(newVariant);
+    for (const UniformBlock &block : uniformBlocks) {
+        bindUniformBlock(newVariant, block);
+    }
+    if (variant) {
+        copyUniforms(*variant, newVariant);
     }
 
+    // a reload in progress has to build the new variant as well
+    if (reloading) {
+        startReloadProgram(variantDefines);
+    }
+
+    return newVariant;
+}
+
+Shader::PendingProgram Shader::startProgram(const std::string &vertexSource, const std::string &fragmentSource) const {
+    PendingProgram program;
+    const char *vertexSourceC = vertexSource.c_str();
     const char *fragmentSourceC = fragmentSource.c_str();
 
     // compile shaders
     // vertex shader
-    unsigned int vertexShader;
-    vertexShader = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(vertexShader, 1, &vertexSourceC, nullptr);
-    glCompileShader(vertexShader);
+    program.vertexShader = glCreateShader(GL_VERTEX_SHADER);
+    glShaderSource(program.vertexShader, 1, &vertexSourceC, nullptr);
+    glCompileShader(program.vertexShader);
+
+    // fragment shader
+    program.fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
+    glShaderSource(program.fragmentShader, 1, &fragmentSourceC, nullptr);
+    glCompileShader(program.fragmentShader);
+
+    // link shader objects into shader program object,
+    // asking for the status would wait for the driver, so that is left to finishProgram
+    program.programID = glCreateProgram();
+    glAttachShader(program.programID, program.vertexShader);
+    glAttachShader(program.programID, program.fragmentShader);
+    if (GLAD_GL_ARB_get_program_binary && !cacheDirectory.empty()) {
+        glProgramParameteri(program.programID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
+    glLinkProgram(program.programID);
+
+    return program;
+}
+
+bool Shader::isProgramComplete(const PendingProgram &program) const {
+    // without parallel shader compile the driver is done once it is asked
+    if (!GLAD_GL_KHR_parallel_shader_compile) {
+        return true;
+    }
 
+    int complete;
+    glGetProgramiv(program.programID, GL_COMPLETION_STATUS_KHR, &complete);
+    return complete;
+}
+
+bool Shader::finishProgram(PendingProgram &program) const {
     int success;
-    glGetShaderiv(vertexShader, GL_COMPILE_STATUS, &success);
+    glGetShaderiv(program.vertexShader, GL_COMPILE_STATUS, &success);
     if (!success) {
         char infoLog[512];
-        glGetShaderInfoLog(vertexShader, 512, nullptr, infoLog);
-        std::cerr << "ERROR::SHADER::VERTEX::COMPILATION_FAILED"
+        glGetShaderInfoLog(program.vertexShader, 512, nullptr, infoLog);
+        std::cerr << "ERROR::SHADER::VERTEX::COMPILATION_FAILED " << vertexPath
                   << std::endl << infoLog << std::endl;
     }
 
-    // fragment shader
-    unsigned int fragmentShader;
-    fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(fragmentShader, 1, &fragmentSourceC, nullptr);
-    glCompileShader(fragmentShader);
-
-    glGetShaderiv(fragmentShader, GL_COMPILE_STATUS, &success);
+    glGetShaderiv(program.fragmentShader, GL_COMPILE_STATUS, &success);
     if (!success) {
         char infoLog[512];
-        glGetShaderInfoLog(fragmentShader, 512, nullptr, infoLog);
-        std::cerr << "ERROR::SHADER::FRAGMENT::COMPILATION_FAILED"
+        glGetShaderInfoLog(program.fragmentShader, 512, nullptr, infoLog);
+        std::cerr << "ERROR::SHADER::FRAGMENT::COMPILATION_FAILED " << fragmentPath
                   << std::endl << infoLog << std::endl;
     }
 
-    // link shader objects into shader program object
-    programID = glCreateProgram();
-    glAttachShader(programID, vertexShader);
-    glAttachShader(programID, fragmentShader);
-    glLinkProgram(programID);
-
-    glGetProgramiv(programID, GL_LINK_STATUS, &success);
-    if (!success) {
+    int linked;
+    glGetProgramiv(program.programID, GL_LINK_STATUS, &linked);
+    if (!linked) {
         char infoLog[512];
-        glGetProgramInfoLog(programID, 512, nullptr, infoLog);
+        glGetProgramInfoLog(program.programID, 512, nullptr, infoLog);
         std::cerr << "ERROR::SHADER::PROGRAM::LINKING_FAILED"
                   << std::endl << infoLog << std::endl;
     }
 
     // delete shader objects
-    glDeleteShader(vertexShader);
-    glDeleteShader(fragmentShader);
+    glDeleteShader(program.vertexShader);
+    glDeleteShader(program.fragmentShader);
+    program.vertexShader = 0;
+    program.fragmentShader = 0;
+
+    return linked;
+}
+
+// 64-bit FNV-1a
+static uint64_t hashString(uint64_t hash, const std::string &string) {
+    for (unsigned char c : string) {
+        hash ^= c;
+        hash *= 0x100000001b3ull;
+    }
+    // separator, so that moving text from one string to the next changes the hash
+    hash ^= 0xff;
+    hash *= 0x100000001b3ull;
+    return hash;
+}
+
+static std::string getString(GLenum name) {
+    const GLubyte *string = glGetString(name);
+    return string ? (const char*)string : "";
+}
+
+std::string Shader::getProgramBinaryPath(const std::string &vertexSource, const std::string &fragmentSource) const {
+    if (!GLAD_GL_ARB_get_program_binary || cacheDirectory.empty()) {
+        return "";
+    }
+
+    // binaries only work with the driver that produced them
+    uint64_t hash = 0xcbf29ce484222325ull;
+    hash = hashString(hash, vertexSource);
+    hash = hashString(hash, fragmentSource);
+    hash = hashString(hash, getString(GL_VENDOR));
+    hash = hashString(hash, getString(GL_RENDERER));
+    hash = hashString(hash, getString(GL_VERSION));
+
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx.bin", (unsigned long long)hash);
+    return cacheDirectory + "/" + name;
+}
+
+bool Shader::loadProgramBinary(Variant &variant, const std::string &path) {
+    if (path.empty()) {
+        return false;
+    }
+
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        return false;
+    }
+
+    file.seekg(0, std::ios::end);
+    std::streamoff size = file.tellg();
+    std::streamoff headerSize = sizeof(PROGRAM_BINARY_MAGIC) + sizeof(GLenum);
+    if (size <= headerSize) {
+        return false;
+    }
+    file.seekg(0);
+
+    char magic[sizeof(PROGRAM_BINARY_MAGIC)];
+    GLenum binaryFormat;
+    std::vector<char> binary(size - headerSize);
+    file.read(magic, sizeof(magic));
+    file.read((char*)&binaryFormat, sizeof(binaryFormat));
+    file.read(binary.data(), binary.size());
+    if (!file || std::memcmp(magic, PROGRAM_BINARY_MAGIC, sizeof(magic)) != 0) {
+        return false;
+    }
+
+    // the driver may have dropped support for the format since
+    int numberOfFormats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &numberOfFormats);
+    std::vector<GLint> formats(numberOfFormats);
+    if (numberOfFormats > 0) {
+        glGetIntegerv(GL_PROGRAM_BINARY_FORMATS, formats.data());
+    }
+    if (std::find(formats.begin(), formats.end(), (GLint)binaryFormat) == formats.end()) {
+        return false;
+    }
+
+    variant.programID = glCreateProgram();
+    glProgramBinary(variant.programID, binaryFormat, binary.data(), binary.size());
+
+    int success;
+    glGetProgramiv(variant.programID, GL_LINK_STATUS, &success);
+    if (!success) {
+        // rejected binaries are compiled again and replaced
+        glDeleteProgram(variant.programID);
+        variant.programID = 0;
+        return false;
+    }
+
+    return true;
+}
+
+void Shader::saveProgramBinary(const Variant &variant, const std::string &path) const {
+    if (path.empty()) {
+        return;
+    }
+
+    int success;
+    glGetProgramiv(variant.programID, GL_LINK_STATUS, &success);
+    int length = 0;
+    glGetProgramiv(variant.programID, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (!success || length <= 0) {
+        return;
+    }
+
+    std::vector<char> binary(length);
+    GLenum binaryFormat;
+    glGetProgramBinary(variant.programID, length, &length, &binaryFormat, binary.data());
+
+    mkdir(cacheDirectory.c_str(), 0755);
+
+    // write to a temporary file first, so that a binary is either complete or missing
+    std::string temporaryPath = path + ".tmp";
+    std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+    file.write(PROGRAM_BINARY_MAGIC, sizeof(PROGRAM_BINARY_MAGIC));
+    file.write((const char*)&binaryFormat, sizeof(binaryFormat));
+    file.write(binary.data(), length);
+    file.close();
+
+    if (!file || std::rename(temporaryPath.c_str(), path.c_str()) != 0) {
+        std::cerr << "ERROR::SHADER::PROGRAM_BINARY_NOT_SUCCESSFULLY_WRITTEN " << path << std::endl;
+        std::remove(temporaryPath.c_str());
+    }
+}
+
+void Shader::setCacheDirectory(const std::string &directory) {
+    cacheDirectory = directory;
+}
+
+bool Shader::watchSourceFiles() {
+    if (inotifyDescriptor >= 0) {
+        return true;
+    }
+
+    inotifyDescriptor = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotifyDescriptor < 0) {
+        std::cerr << "ERROR::SHADER::SOURCE_FILES_NOT_WATCHED" << std::endl;
+        return false;
+    }
+
+    // let the driver use as many threads as it likes for compiling in the background
+    if (GLAD_GL_KHR_parallel_shader_compile) {
+        glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+    }
+
+    for (Shader *shader : shaders) {
+        shader->watchSourceDirectories();
+    }
+    return true;
+}
+
+void Shader::reloadChangedShaders() {
+    if (inotifyDescriptor < 0) {
+        return;
+    }
+
+    // editors either write the file or move a new one in its place
+    std::vector<std::string> changedFiles;
+    alignas(inotify_event) char buffer[4096];
+    ssize_t length;
+    while ((length = read(inotifyDescriptor, buffer, sizeof(buffer))) > 0) {
+        for (char *position = buffer; position < buffer + length; ) {
+            const inotify_event *event = (const inotify_event*)position;
+            auto directory = watchedDirectories.find(event->wd);
+            if (directory != watchedDirectories.end() && event->len > 0) {
+                changedFiles.push_back(directory->second + event->name);
+            }
+            position += sizeof(inotify_event) + event->len;
+        }
+    }
+
+    for (Shader *shader : shaders) {
+        for (const std::string &file : changedFiles) {
+            if (shader->usesSourceFile(file)) {
+                // a change during a reload starts it over
+                shader->startReload();
+                break;
+            }
+        }
+        if (shader->reloading) {
+            shader->finishReload();
+        }
+    }
+}
+
+void Shader::watchSourceDirectories() {
+    if (inotifyDescriptor < 0) {
+        return;
+    }
+
+    for (const std::string &file : sourceFiles) {
+        std::string directory = file.substr(0, file.find_last_of('/') + 1);
+
+        bool watched = false;
+        for (const auto &entry : watchedDirectories) {
+            watched = watched || entry.second == directory;
+        }
+        if (watched) {
+            continue;
+        }
+
+        int watch = inotify_add_watch(inotifyDescriptor, directory.empty() ? "." : directory.c_str(),
+                                      IN_CLOSE_WRITE | IN_MOVED_TO);
+        if (watch < 0) {
+            std::cerr << "ERROR::SHADER::DIRECTORY_NOT_WATCHED " << directory << std::endl;
+            continue;
+        }
+        watchedDirectories[watch] = directory;
+    }
+}
+
+bool Shader::usesSourceFile(const std::string &path) const {
+    return std::find(sourceFiles.begin(), sourceFiles.end(), path) != sourceFiles.end();
+}
+
+void Shader::startReload() {
+    discardReload();
+
+    // an #include may have been added, its directory is watched from now on
+    readSources(reloadVertexSource, reloadFragmentSource);
+    watchSourceDirectories();
+
+    reloading = true;
+    for (const auto &entry : variants) {
+        startReloadProgram(entry.first);
+    }
+    std::cout << "INFO::SHADER::RELOADING " << vertexPath << " " << fragmentPath << std::endl;
+}
+
+void Shader::startReloadProgram(const std::vector<std::string> &variantDefines) {
+    std::string variantVertexSource = addDefines(reloadVertexSource, variantDefines);
+    std::string variantFragmentSource = addDefines(reloadFragmentSource, variantDefines);
+
+    PendingProgram &program = pendingPrograms[variantDefines];
+    program = startProgram(variantVertexSource, variantFragmentSource);
+    program.binaryPath = getProgramBinaryPath(variantVertexSource, variantFragmentSource);
+}
+
+void Shader::finishReload() {
+    for (const auto &entry : pendingPrograms) {
+        if (!isProgramComplete(entry.second)) {
+            return;
+        }
+    }
+
+    // all variants have to build, otherwise nothing changes
+    bool success = true;
+    for (auto &entry : pendingPrograms) {
+        success = finishProgram(entry.second) && success;
+    }
+    if (!success) {
+        std::cerr << "ERROR::SHADER::RELOAD_FAILED " << vertexPath << " " << fragmentPath
+                  << ", keeping the previous program" << std::endl;
+        discardReload();
+        return;
+    }
+
+    // swap the programs within the variants, so that the current variant stays valid
+    for (auto &entry : pendingPrograms) {
+        Variant &oldVariant = variants[entry.first];
+        Variant newVariant;
+        newVariant.programID = entry.second.programID;
+
+        findUniforms(newVariant);
+        for (const UniformBlock &block : uniformBlocks) {
+            bindUniformBlock(newVariant, block);
+        }
+        copyUniforms(oldVariant, newVariant);
+
+        glDeleteProgram(oldVariant.programID);
+        oldVariant = newVariant;
+        saveProgramBinary(oldVariant, entry.second.binaryPath);
+    }
+    pendingPrograms.clear();
+
+    vertexSource = reloadVertexSource;
+    fragmentSource = reloadFragmentSource;
+    reloading = false;
+    std::cout << "INFO::SHADER::RELOADED " << vertexPath << " " << fragmentPath << std::endl;
+}
+
+void Shader::discardReload() {
+    for (auto &entry : pendingPrograms) {
+        glDeleteShader(entry.second.vertexShader);
+        glDeleteShader(entry.second.fragmentShader);
+        glDeleteProgram(entry.second.programID);
+    }
+    pendingPrograms.clear();
+    reloading = false;
+}
+
+void Shader::findUniforms(Variant &variant) {
+    unsigned int programID = variant.programID;
+    variant.uniforms.clear();
+
+    int numberOfUniforms = 0;
+    int maxNameLength = 0;
+    glGetProgramiv(programID, GL_ACTIVE_UNIFORMS, &numberOfUniforms);
+    glGetProgramiv(programID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxNameLength);
+
+    std::string name(std::max(maxNameLength, 1), '\0');
+    for (int i = 0; i < numberOfUniforms; ++i) {
+        GLsizei length = 0;
+        GLint size = 0;
+        GLenum type;
+        glGetActiveUniform(programID, i, name.size(), &length, &size, &type, &name[0]);
+
+        std::string uniformName = name.substr(0, length);
+        GLint location = glGetUniformLocation(programID, uniformName.c_str());
+        if (location < 0) {
+            // part of a uniform block
+            continue;
+        }
+        variant.uniforms[uniformName] = {location, type};
+
+        // arrays are reported as "name[0]", their elements can be set as "name[i]"
+        // and the first one also as "name"
+        size_t bracket = uniformName.rfind("[0]");
+        if (bracket != std::string::npos && bracket + 3 == uniformName.size()) {
+            std::string arrayName = uniformName.substr(0, bracket);
+            variant.uniforms[arrayName] = {location, type};
+
+            for (int element = 1; element < size; ++element) {
+                std::string elementName = arrayName + "[" + std::to_string(element) + "]";
+                variant.uniforms[elementName] = {glGetUniformLocation(programID, elementName.c_str()), type};
+            }
+        }
+    }
+
+    auto modelView = variant.uniforms.find("modelView");
+    variant.modelViewLocation = (modelView != variant.uniforms.end()) ? modelView->second.location : -1;
+    auto normalMatrix = variant.uniforms.find("normalMatrix");
+    variant.normalMatrixLocation = (normalMatrix != variant.uniforms.end()) ? normalMatrix->second.location : -1;
+}
+
+void Shader::copyUniforms(const Variant &from, const Variant &to) const {
+    GLint currentProgram = 0;
+    glGetIntegerv(GL_CURRENT_PROGRAM, &currentProgram);
+    glUseProgram(to.programID);
+
+    for (const auto &entry : from.uniforms) {
+        auto target = to.uniforms.find(entry.first);
+        if (target == to.uniforms.end() || target->second.type != entry.second.type) {
+            continue;
+        }
+
+        GLint location = target->second.location;
+        GLfloat floats[16];
+        GLint ints[1];
+
+        switch (entry.second.type) {
+        case GL_FLOAT:
+            glGetUniformfv(from.programID, entry.second.location, floats);
+            glUniform1fv(location, 1, floats);
+            break;
+        case GL_FLOAT_VEC2:
+            glGetUniformfv(from.programID, entry.second.location, floats);
+            glUniform2fv(location, 1, floats);
+            break;
+        case GL_FLOAT_VEC3:
+            glGetUniformfv(from.programID, entry.second.location, floats);
+            glUniform3fv(location, 1, floats);
+            break;
+        case GL_FLOAT_VEC4:
+            glGetUniformfv(from.programID, entry.second.location, floats);
+            glUniform4fv(location, 1, floats);
+            break;
+        case GL_FLOAT_MAT3:
+            glGetUniformfv(from.programID, entry.second.location, floats);
+            glUniformMatrix3fv(location, 1, GL_FALSE, floats);
+            break;
+        case GL_FLOAT_MAT4:
+            glGetUniformfv(from.programID, entry.second.location, floats);
+            glUniformMatrix4fv(location, 1, GL_FALSE, floats);
+            break;
+        case GL_INT:
+        case GL_BOOL:
+        case GL_SAMPLER_2D:
+        case GL_SAMPLER_CUBE:
+            glGetUniformiv(from.programID, entry.second.location, ints);
+            glUniform1i(location, ints[0]);
+            break;
+        }
+    }
+
+    glUseProgram(currentProgram);
 }
 
 void Shader::use() {
-    glUseProgram(programID);
+    glUseProgram(variant->programID);
+}
+
+void Shader::use(const Variant &variant) const {
+    glUseProgram(variant.programID);
+}
+
+unsigned int Shader::getProgramID() const {
+    return variant->programID;
+}
+
+GLint Shader::getUniformLocation(const std::string &name) const {
+    return getUniformLocation(*variant, name);
+}
+
+GLint Shader::getUniformLocation(const Variant &variant, const std::string &name) const {
+    auto entry = variant.uniforms.find(name);
+    if (entry == variant.uniforms.end()) {
+        // inactive uniforms are ignored by glUniform*() with location -1
+        return -1;
+    }
+    return entry->second.location;
+}
+
+void Shader::setViewMatrix(const glm::mat4 &view) {
+    viewMatrix = view;
+}
+
+const glm::mat4& Shader::getViewMatrix() {
+    return viewMatrix;
+}
+
+void Shader::setModelMatrix(const glm::mat4 &model) const {
+    glm::mat4 modelView = viewMatrix * model;
+    setMat4(variant->modelViewLocation, modelView);
+
+    // the inverse transpose of the upper 3x3 is enough for the affine model-view matrix
+    if (variant->normalMatrixLocation >= 0) {
+        setMat3(variant->normalMatrixLocation, glm::inverseTranspose(glm::mat3(modelView)));
+    }
+}
+
+void Shader::bindUniformBlock(const std::string &name, GLuint bindingPoint, GLint size) {
+    UniformBlock block = {name, bindingPoint, size};
+    uniformBlocks.push_back(block);
+
+    for (const auto &entry : variants) {
+        bindUniformBlock(entry.second, block);
+    }
+}
+
+void Shader::bindUniformBlock(const Variant &variant, const UniformBlock &block) const {
+    GLuint blockIndex = glGetUniformBlockIndex(variant.programID, block.name.c_str());
+    if (blockIndex == GL_INVALID_INDEX) {
+        return;
+    }
+
+    GLint blockSize = 0;
+    glGetActiveUniformBlockiv(variant.programID, blockIndex, GL_UNIFORM_BLOCK_DATA_SIZE, &blockSize);
+    if (blockSize != block.size) {
+        std::cerr << "ERROR::SHADER::UNIFORM_BLOCK_SIZE_MISMATCH " << block.name
+                  << " has " << blockSize << " bytes instead of " << block.size << std::endl;
+    }
+
+    glUniformBlockBinding(variant.programID, blockIndex, block.bindingPoint);
+}
+
+void Shader::setBool(GLint location, bool value) const {
+    glUniform1i(location, (int)value);
+}
+
+void Shader::setInt(GLint location, int value) const {
+    glUniform1i(location, value);
+}
+
+void Shader::setFloat(GLint location, float value) const {
+    glUniform1f(location, value);
+}
+
+void Shader::setMat3(GLint location, const glm::mat3 &value) const {
+    glUniformMatrix3fv(location, 1, GL_FALSE, glm::value_ptr(value));
+}
+
+void Shader::setMat4(GLint location, const glm::mat4 &value) const {
+    glUniformMatrix4fv(location, 1, GL_FALSE, glm::value_ptr(value));
+}
+
+void Shader::setVec3v(GLint location, const glm::vec3 &value) const {
+    glUniform3fv(location, 1, glm::value_ptr(value));
+}
+
+void Shader::setVec3(GLint location, float x, float y, float z) const {
+    glUniform3f(location, x, y, z);
 }
 
 void Shader::setBool(const std::string &name, bool value) const {
-    glUniform1i(glGetUniformLocation(programID, name.c_str()), (int)value);
+    glUniform1i(getUniformLocation(name), (int)value);
 }
 
 void Shader::setInt(const std::string &name, int value) const {
-    glUniform1i(glGetUniformLocation(programID, name.c_str()), value);
+    glUniform1i(getUniformLocation(name), value);
 }
 
 void Shader::setFloat(const std::string &name, float value) const {
-    glUniform1f(glGetUniformLocation(programID, name.c_str()), value);
+    glUniform1f(getUniformLocation(name), value);
+}
+
+void Shader::setMat3(const std::string &name, const glm::mat3 &value) const {
+    glUniformMatrix3fv(getUniformLocation(name), 1, GL_FALSE, glm::value_ptr(value));
 }
 
 void Shader::setMat4(const std::string &name, const glm::mat4 &value) const {
-    glUniformMatrix4fv(glGetUniformLocation(programID, name.c_str()), 1, GL_FALSE, glm::value_ptr(value));
+    glUniformMatrix4fv(getUniformLocation(name), 1, GL_FALSE, glm::value_ptr(value));
 }
 
 void Shader::setVec3v(const std::string &name, const glm::vec3 &value) const {
-    glUniform3fv(glGetUniformLocation(programID, name.c_str()), 1, glm::value_ptr(value));
+    glUniform3fv(getUniformLocation(name), 1, glm::value_ptr(value));
 }
 
 void Shader::setVec3(const std::string &name, float x, float y, float z) const {
-    glUniform3f(glGetUniformLocation(programID, name.c_str()), x, y, z);
+    glUniform3f(getUniformLocation(name), x, y, z);
 }
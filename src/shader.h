@@ -3,30 +3,191 @@
 
 #include <fstream>
 #include <iostream>
+#include <map>
 #include <sstream>
 #include <string>
+#include <unordered_map>
+#include <vector>
 
 #include <glad/glad.h>
 #include <glm/glm.hpp>
+#include <glm/gtc/matrix_inverse.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
 
 class Shader {
+public:
+    struct Uniform {
+        GLint location;
+        GLenum type;
+    };
+
+    // one program per set of #defines, it stays at the same address as long as the shader
+    // exists (a reload swaps the program within it)
+    struct Variant {
+        // program ID
+        unsigned int programID = 0;
+
+        // all active uniforms, looked up once after linking
+        std::unordered_map<std::string, Uniform> uniforms;
+
+        // locations of the model-view and normal matrix most shaders have
+        GLint modelViewLocation = -1;
+        GLint normalMatrixLocation = -1;
+    };
+
 private:
-    // program ID
-    unsigned int programID;
+
+    struct UniformBlock {
+        std::string name;
+        GLuint bindingPoint;
+        GLint size;
+    };
+
+    // program that is compiled and linked, possibly in the background
+    struct PendingProgram {
+        unsigned int programID = 0;
+        unsigned int vertexShader = 0;
+        unsigned int fragmentShader = 0;
+        std::string binaryPath;
+    };
+
+    std::string vertexPath;
+    std::string fragmentPath;
+
+    // sources with all #includes resolved
+    std::string vertexSource;
+    std::string fragmentSource;
+    // the files they were read from, including the included ones
+    std::vector<std::string> sourceFiles;
+
+    // defines of the current variant, sorted, "NAME" or "NAME VALUE"
+    std::vector<std::string> defines;
+    std::map<std::vector<std::string>, Variant> variants;
+    Variant *variant;
+
+    // bound in every variant
+    std::vector<UniformBlock> uniformBlocks;
+
+    // reload: new sources and one program per variant, swapped in once all of them linked
+    bool reloading;
+    std::string reloadVertexSource;
+    std::string reloadFragmentSource;
+    std::map<std::vector<std::string>, PendingProgram> pendingPrograms;
+
+    // directory for compiled program binaries, empty if they are not cached
+    static std::string cacheDirectory;
+
+    // view matrix of the current frame, combined with the model matrices on the CPU
+    static glm::mat4 viewMatrix;
+
+    // all shaders and the watched source directories for reloading them
+    static std::vector<Shader*> shaders;
+    static int inotifyDescriptor;
+    static std::map<int, std::string> watchedDirectories;
+
+    // the source number of a file is its index in files
+    static std::string readSourceFile(const std::string &path, int depth, std::vector<std::string> &files);
+    static std::string addDefines(const std::string &source, const std::vector<std::string> &defines);
+
+    // the current defines with the define added or removed
+    std::vector<std::string> changeDefine(const std::string &name, bool enabled) const;
+    // the variant of the defines, built if there is none yet
+    Variant& findVariant(const std::vector<std::string> &variantDefines);
+    // compile and link without waiting for the driver, finishProgram checks the result
+    PendingProgram startProgram(const std::string &vertexSource, const std::string &fragmentSource) const;
+    bool isProgramComplete(const PendingProgram &program) const;
+    bool finishProgram(PendingProgram &program) const;
+    // program binaries are looked up by a hash of the sources and the driver
+    std::string getProgramBinaryPath(const std::string &vertexSource, const std::string &fragmentSource) const;
+    bool loadProgramBinary(Variant &variant, const std::string &path);
+    void saveProgramBinary(const Variant &variant, const std::string &path) const;
+    void findUniforms(Variant &variant);
+    void bindUniformBlock(const Variant &variant, const UniformBlock &block) const;
+    // give a new variant the uniform values of the previous one
+    void copyUniforms(const Variant &from, const Variant &to) const;
+
+    // reads the sources again and updates sourceFiles
+    void readSources(std::string &newVertexSource, std::string &newFragmentSource);
+    void watchSourceDirectories();
+    bool usesSourceFile(const std::string &path) const;
+    // build all variants from the current files, the old programs stay in use meanwhile
+    void startReload();
+    void startReloadProgram(const std::vector<std::string> &variantDefines);
+    void finishReload();
+    void discardReload();
 
 public:
-    // constructor reads source and builds shader
-    Shader(const char *vertexPath, const char *fragmentPath);
+    static const char *DEFAULT_CACHE_DIRECTORY;
+
+    // constructor reads source and builds shader,
+    // or loads the program binary from the cache if the same sources were built before;
+    // the sources may #include "file" relative to themselves and are compiled with the
+    // given #defines ("NAME" or "NAME VALUE")
+    Shader(const char *vertexPath, const char *fragmentPath,
+           const std::vector<std::string> &defines = std::vector<std::string>());
+    ~Shader();
+
+    Shader(const Shader&) = delete;
+    Shader& operator=(const Shader&) = delete;
+
+    // empty to always compile the shaders
+    static void setCacheDirectory(const std::string &directory);
+
+    // watch the source files of all shaders, also of those created later, for changes;
+    // reloadChangedShaders then recompiles changed shaders in the background (in parallel
+    // if the driver supports it) and swaps in the new programs once they linked successfully,
+    // a failed build keeps the old programs
+    static bool watchSourceFiles();
+    static void reloadChangedShaders();
+
+    // add or remove a define, which switches to another variant of the shader that is
+    // built on first use; uniform values carry over to new variants,
+    // uniform locations belong to the current variant
+    void setDefine(const std::string &name, bool enabled);
+    unsigned int getNumberOfVariants() const;
+    // the variant with the define added to the current defines, built if there is none yet,
+    // for switching to it on the draw path without changing the defines (RenderQueue)
+    Variant* getVariant(const std::string &define);
+    // variant of the current defines, changes with setDefine
+    const Variant* getCurrentVariant() const;
 
     // use/activate the shader
     void use();
+    // use the given variant instead of the current one
+    void use(const Variant &variant) const;
+    // program of the current variant
+    unsigned int getProgramID() const;
+
+    // location of a uniform for the setters below, -1 if the shader does not use it
+    GLint getUniformLocation(const std::string &name) const;
+    GLint getUniformLocation(const Variant &variant, const std::string &name) const;
+
+    // camera of the current frame, the view matrix is also in the Camera uniform block
+    static void setViewMatrix(const glm::mat4 &view);
+    static const glm::mat4& getViewMatrix();
+    // set the uniforms modelView and normalMatrix for an object with the given model matrix,
+    // so that the vertex shaders do not invert a matrix per vertex
+    void setModelMatrix(const glm::mat4 &model) const;
+
+    // attach the uniform block to a binding point if the shader has it, in all variants,
+    // size is the one of the matching C++ struct and checked against the shader
+    void bindUniformBlock(const std::string &name, GLuint bindingPoint, GLint size);
+
+    // functions for setting uniforms by location
+    void setBool(GLint location, bool value) const;
+    void setInt(GLint location, int value) const;
+    void setFloat(GLint location, float value) const;
+    void setMat3(GLint location, const glm::mat3 &value) const;
+    void setMat4(GLint location, const glm::mat4 &value) const;
+    void setVec3v(GLint location, const glm::vec3 &value) const;
+    void setVec3(GLint location, float x, float y, float z) const;
 
-    // functions for setting uniforms
+    // functions for setting uniforms by name
     void setBool(const std::string &name, bool value) const;
     void setInt(const std::string &name, int value) const;
     void setFloat(const std::string &name, float value) const;
+    void setMat3(const std::string &name, const glm::mat3 &value) const;
     void setMat4(const std::string &name, const glm::mat4 &value) const;
     void setVec3v(const std::string &name, const glm::vec3 &value) const;
     void setVec3(const std::string &name, float x, float y, float z) const;
@@ -0,0 +1,965 @@
+#include "terrain.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+
+#include <glad/glad.h>
+
+Terrain::Terrain(HeightMap &heightMap, int chunkSize)
+    : heightMap(&heightMap),
+      chunkSize(chunkSize) {
+    setUp();
+    setBounds(heightMap.getWidth(), heightMap.getDepth());
+
+    // chunks at the far borders may reach beyond the map
+    int chunksX = (heightMap.getWidth() - 2) / chunkSize + 1;
+    int chunksY = (heightMap.getDepth() - 2) / chunkSize + 1;
+
+    for (int y = 0; y < chunksY; ++y) {
+        for (int x = 0; x < chunksX; ++x) {
+            TerrainChunk *chunk = prepareChunk(x, y);
+            uploadChunk(*chunk);
+            chunks[chunkKey(x, y)] = chunk;
+        }
+    }
+
+    std::cout << "INFO::TERRAIN " << chunksX << "x" << chunksY << " chunks of "
+              << chunkSize << "x" << chunkSize << " squares, "
+              << numberOfLevels << " levels of detail" << std::endl;
+}
+
+Terrain::Terrain(HeightGenerator generator, int chunkSize)
+    : heightMap(nullptr),
+      generator(generator),
+      chunkSize(chunkSize) {
+    setUp();
+    startWorkers();
+
+    std::cout << "INFO::TERRAIN Streaming chunks of " << chunkSize << "x" << chunkSize << " squares, "
+              << numberOfLevels << " levels of detail, at most " << maximumNumberOfChunks
+              << " chunks with " << workers.size() << " workers" << std::endl;
+}
+
+Terrain::~Terrain() {
+    stopAllWorkers();
+
+    for (auto &entry : chunks) {
+        deleteChunk(entry.second);
+    }
+    for (TerrainChunk *chunk : preparedChunks) {
+        deleteChunk(chunk);
+    }
+    glDeleteBuffers(1, &EBO);
+}
+
+long long Terrain::chunkKey(int x, int y) {
+    return ((long long)x << 32) | (unsigned int)y;
+}
+
+int Terrain::chunkCoordinate(int position, int chunkSize) {
+    // round towards negative infinity, also for negative positions
+    return (position >= 0) ? position / chunkSize : -((-position - 1) / chunkSize) - 1;
+}
+
+void Terrain::setUp() {
+    // every level of detail halves the resolution of the previous one
+    numberOfLevels = 1;
+    while ((chunkSize >> (numberOfLevels - 1)) % 2 == 0) {
+        ++numberOfLevels;
+    }
+
+    pixelErrorThreshold = 2.0f;
+    drawnTriangles = 0;
+    drawnChunks = 0;
+    occludedChunks = 0;
+    firstOccluderLevel = std::min(3, numberOfLevels - 1);
+
+    gridWidth = 0;
+    gridDepth = 0;
+
+    loadRadius = DEFAULT_LOAD_RADIUS;
+    uploadsPerFrame = 4;
+    stopWorkers = false;
+    setMemoryBudget(DEFAULT_MEMORY_BUDGET);
+
+    Texture texture = Texture::createTextureFromFile("textures/moon2.jpg", "texture_diffuse");
+    textures.push_back(texture);
+    Texture texture_specular = Texture::createTextureFromFile("textures/moon2_specular.jpg", "texture_specular");
+    textures.push_back(texture_specular);
+    for (const Texture &texture : textures) {
+        samplerNames.push_back("material." + texture.type + "1");
+    }
+
+    setUpIndices();
+}
+
+void Terrain::setUpIndices() {
+    std::vector<unsigned int> indices;
+
+    for (int level = 0; level < numberOfLevels; ++level) {
+        for (int stitchedEdges = 0; stitchedEdges < NUMBER_OF_EDGE_COMBINATIONS; ++stitchedEdges) {
+            IndexRange range;
+            range.offset = indices.size() * sizeof(unsigned int);
+
+            generateIndices(level, stitchedEdges, indices);
+
+            range.count = indices.size() - range.offset / sizeof(unsigned int);
+            indexRanges.push_back(range);
+        }
+    }
+
+    glGenBuffers(1, &EBO);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int),
+                 &indices[0], GL_STATIC_DRAW);
+}
+
+void Terrain::generateIndices(int level, int stitchedEdges, std::vector<unsigned int> &indices) const {
+    int verticesPerRow = chunkSize + 1;
+    int step = 1 << level;
+
+    // index of a vertex of this level; on a stitched edge, every other vertex is moved onto
+    // its predecessor, so that the edge matches the neighbour with half the resolution
+    auto index = [&](int x, int y) {
+        if (((x == 0 && (stitchedEdges & EDGE_LEFT)) || (x == chunkSize && (stitchedEdges & EDGE_RIGHT)))
+            && (y / step) % 2 == 1) {
+            y -= step;
+        }
+        if (((y == 0 && (stitchedEdges & EDGE_BOTTOM)) || (y == chunkSize && (stitchedEdges & EDGE_TOP)))
+            && (x / step) % 2 == 1) {
+            x -= step;
+        }
+
+        return (unsigned int)(y * verticesPerRow + x);
+    };
+
+    auto addTriangle = [&](unsigned int a, unsigned int b, unsigned int c) {
+        // moved vertices collapse some triangles, those are left out
+        if (a != b && b != c && a != c) {
+            indices.push_back(a);
+            indices.push_back(b);
+            indices.push_back(c);
+        }
+    };
+
+    // two triangles per square, in the same order as the original mesh
+    for (int y = step; y <= chunkSize; y += step) {
+        for (int x = step; x <= chunkSize; x += step) {
+            // current square
+            unsigned int ll = index(x - step, y - step);
+            unsigned int lr = index(x, y - step);
+            unsigned int ul = index(x - step, y);
+            unsigned int ur = index(x, y);
+
+            addTriangle(ll, ul, lr);
+            addTriangle(ul, lr, ur);
+        }
+    }
+}
+
+TerrainChunk* Terrain::prepareChunk(int x, int y) const {
+    TerrainChunk *chunk = new TerrainChunk;
+    chunk->x = x;
+    chunk->y = y;
+    chunk->VAO = 0;
+    chunk->VBO = 0;
+    chunk->level = 0;
+    chunk->heights = nullptr;
+
+    if (!heightMap) {
+        chunk->heights = new HeightMap(chunkSize + 3, chunkSize + 3);
+        chunk->heights->fillMap(generator, x * chunkSize - 1, y * chunkSize - 1);
+    }
+
+    prepareVertices(*chunk);
+
+    return chunk;
+}
+
+float Terrain::chunkHeight(const TerrainChunk &chunk, int x, int y) const {
+    if (chunk.heights) {
+        return chunk.heights->getHeightAt(x + 1, y + 1);
+    }
+
+    return heightMap->getHeightAt(std::min(chunk.x * chunkSize + x, heightMap->getWidth() - 1),
+                                  std::min(chunk.y * chunkSize + y, heightMap->getDepth() - 1));
+}
+
+glm::vec3 Terrain::chunkNormal(const TerrainChunk &chunk, int x, int y) const {
+    if (chunk.heights) {
+        return chunk.heights->getNormal(x + 1, y + 1);
+    }
+
+    return heightMap->getNormal(std::min(chunk.x * chunkSize + x, heightMap->getWidth() - 1),
+                                std::min(chunk.y * chunkSize + y, heightMap->getDepth() - 1));
+}
+
+Vertex Terrain::computeVertex(const TerrainChunk &chunk, int x, int y) const {
+    int worldX = chunk.x * chunkSize + x;
+    int worldY = chunk.y * chunkSize + y;
+    if (isBounded()) {
+        // vertices beyond the border collapse onto it, their squares have no area
+        worldX = std::min(worldX, gridWidth - 1);
+        worldY = std::min(worldY, gridDepth - 1);
+    }
+
+    int localX = worldX - chunk.x * chunkSize;
+    int localY = worldY - chunk.y * chunkSize;
+
+    Vertex vertex;
+    vertex.position = glm::vec3((float) worldX, chunkHeight(chunk, localX, localY), (float) worldY);
+    vertex.normal = chunkNormal(chunk, localX, localY);
+    // the terrain textures repeat, so every square shows one full texture
+    vertex.textureCoordinates = glm::vec2((float) worldX, (float) worldY);
+
+    return vertex;
+}
+
+void Terrain::prepareVertices(TerrainChunk &chunk) const {
+    chunk.vertices.clear();
+    chunk.vertices.reserve((chunkSize + 1) * (chunkSize + 1));
+
+    chunk.minimum = glm::vec3(std::numeric_limits<float>::infinity());
+    chunk.maximum = glm::vec3(-std::numeric_limits<float>::infinity());
+
+    for (int y = 0; y <= chunkSize; ++y) {
+        for (int x = 0; x <= chunkSize; ++x) {
+            Vertex vertex = computeVertex(chunk, x, y);
+            chunk.vertices.push_back(vertex);
+
+            chunk.minimum = glm::min(chunk.minimum, vertex.position);
+            chunk.maximum = glm::max(chunk.maximum, vertex.position);
+        }
+    }
+
+    chunk.errors.assign(numberOfLevels, 0.0f);
+    updateErrors(chunk, 0, 0, chunkSize, chunkSize);
+    updateOccluders(chunk);
+}
+
+void Terrain::updateErrors(TerrainChunk &chunk, int firstX, int firstY, int lastX, int lastY) const {
+    // the coarse levels interpolate across most of the chunk, so fetch all heights once
+    int size = chunkSize + 1;
+    std::vector<float> heights(size * size);
+    for (int y = 0; y < size; ++y) {
+        for (int x = 0; x < size; ++x) {
+            heights[y * size + x] = chunkHeight(chunk, x, y);
+        }
+    }
+
+    // error of each level: largest difference between a height and its interpolation
+    // from the grid points of that level
+    for (int level = 1; level < numberOfLevels; ++level) {
+        int step = 1 << level;
+
+        // every point interpolated from a changed grid point of this level
+        int levelFirstX = std::max(firstX / step * step - step, 0);
+        int levelFirstY = std::max(firstY / step * step - step, 0);
+        int levelLastX = std::min((lastX + step - 1) / step * step + step, chunkSize);
+        int levelLastY = std::min((lastY + step - 1) / step * step + step, chunkSize);
+
+        for (int y = levelFirstY; y <= levelLastY; ++y) {
+            for (int x = levelFirstX; x <= levelLastX; ++x) {
+                int lowerX = std::min(x / step * step, chunkSize - step);
+                int lowerY = std::min(y / step * step, chunkSize - step);
+                float s = (float)(x - lowerX) / step;
+                float t = (float)(y - lowerY) / step;
+
+                const float *lower = &heights[lowerY * size + lowerX];
+                const float *upper = lower + step * size;
+                float interpolated = (1 - t) * ((1 - s) * lower[0] + s * lower[step])
+                                     + t * ((1 - s) * upper[0] + s * upper[step]);
+
+                chunk.errors[level] = std::max(chunk.errors[level], std::abs(heights[y * size + x] - interpolated));
+            }
+        }
+
+        // a coarser level never looks better than a finer one
+        chunk.errors[level] = std::max(chunk.errors[level], chunk.errors[level - 1]);
+    }
+}
+
+void Terrain::updateOccluders(TerrainChunk &chunk) const {
+    chunk.occluderHeights.resize(numberOfLevels - firstOccluderLevel);
+
+    // lowest height of each square of the first occluder level, including its border
+    int step = 1 << firstOccluderLevel;
+    int squares = chunkSize >> firstOccluderLevel;
+    std::vector<float> &first = chunk.occluderHeights[0];
+    first.assign(squares * squares, std::numeric_limits<float>::infinity());
+    for (int y = 0; y <= chunkSize; ++y) {
+        for (int x = 0; x <= chunkSize; ++x) {
+            float height = chunkHeight(chunk, x, y);
+
+            // grid points on the border between squares belong to all of them
+            for (int squareY = std::max((y - 1) / step, 0); squareY <= std::min(y / step, squares - 1); ++squareY) {
+                for (int squareX = std::max((x - 1) / step, 0); squareX <= std::min(x / step, squares - 1); ++squareX) {
+                    float &lowest = first[squareY * squares + squareX];
+                    lowest = std::min(lowest, height);
+                }
+            }
+        }
+    }
+
+    // every further level combines 2x2 squares
+    for (unsigned int level = 1; level < chunk.occluderHeights.size(); ++level) {
+        const std::vector<float> &below = chunk.occluderHeights[level - 1];
+        int belowSquares = squares;
+        squares /= 2;
+
+        std::vector<float> &heights = chunk.occluderHeights[level];
+        heights.resize(squares * squares);
+        for (int y = 0; y < squares; ++y) {
+            for (int x = 0; x < squares; ++x) {
+                const float *lower = &below[2 * y * belowSquares + 2 * x];
+                const float *upper = lower + belowSquares;
+                heights[y * squares + x] = std::min(std::min(lower[0], lower[1]), std::min(upper[0], upper[1]));
+            }
+        }
+    }
+}
+
+void Terrain::uploadChunk(TerrainChunk &chunk) {
+    if (chunk.VAO == 0) {
+        glGenVertexArrays(1, &chunk.VAO);
+        glGenBuffers(1, &chunk.VBO);
+    }
+
+    glBindVertexArray(chunk.VAO);
+
+    glBindBuffer(GL_ARRAY_BUFFER, chunk.VBO);
+    glBufferData(GL_ARRAY_BUFFER, chunk.vertices.size() * sizeof(Vertex),
+                 &chunk.vertices[0], GL_STATIC_DRAW);
+
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+
+    Mesh::setUpVertexAttributes();
+
+    glBindVertexArray(0);
+
+    // the GPU has its own copy now
+    std::vector<Vertex>().swap(chunk.vertices);
+}
+
+void Terrain::deleteChunk(TerrainChunk *chunk) {
+    if (chunk->VAO != 0) {
+        glDeleteVertexArrays(1, &chunk->VAO);
+        glDeleteBuffers(1, &chunk->VBO);
+    }
+
+    delete chunk->heights;
+    delete chunk;
+}
+
+void Terrain::runWorker() {
+    while (true) {
+        std::pair<int, int> job;
+        {
+            std::unique_lock<std::mutex> lock(queueMutex);
+            queueCondition.wait(lock, [this] { return stopWorkers || !jobs.empty(); });
+
+            if (stopWorkers) {
+                return;
+            }
+
+            job = jobs.front();
+            jobs.pop_front();
+        }
+
+        TerrainChunk *chunk = prepareChunk(job.first, job.second);
+
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            preparedChunks.push_back(chunk);
+        }
+    }
+}
+
+void Terrain::startWorkers() {
+    // leave one core to the render thread
+    unsigned int numberOfWorkers = std::max(1u, std::thread::hardware_concurrency() - 1);
+
+    for (unsigned int i = 0; i < numberOfWorkers; ++i) {
+        workers.push_back(std::thread(&Terrain::runWorker, this));
+    }
+}
+
+void Terrain::stopAllWorkers() {
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        stopWorkers = true;
+    }
+    queueCondition.notify_all();
+
+    for (std::thread &worker : workers) {
+        worker.join();
+    }
+    workers.clear();
+}
+
+void Terrain::update(const glm::vec3 &cameraPosition) {
+    if (!isStreaming()) {
+        return;
+    }
+
+    int cameraX = chunkCoordinate((int)std::floor(cameraPosition.x), chunkSize);
+    int cameraY = chunkCoordinate((int)std::floor(cameraPosition.z), chunkSize);
+
+    auto squaredDistance = [&](int x, int y) {
+        return (x - cameraX) * (x - cameraX) + (y - cameraY) * (y - cameraY);
+    };
+
+    // chunks around the camera, nearest first, as many as the budget allows
+    std::vector<std::pair<int, int>> wantedChunks;
+    for (int y = cameraY - loadRadius; y <= cameraY + loadRadius; ++y) {
+        for (int x = cameraX - loadRadius; x <= cameraX + loadRadius; ++x) {
+            if (squaredDistance(x, y) <= loadRadius * loadRadius && isChunkInBounds(x, y)) {
+                wantedChunks.push_back(std::make_pair(x, y));
+            }
+        }
+    }
+
+    std::sort(wantedChunks.begin(), wantedChunks.end(),
+              [&](const std::pair<int, int> &a, const std::pair<int, int> &b) {
+                  return squaredDistance(a.first, a.second) < squaredDistance(b.first, b.second);
+              });
+    if (wantedChunks.size() > maximumNumberOfChunks) {
+        wantedChunks.resize(maximumNumberOfChunks);
+    }
+
+    std::unordered_set<long long> wantedKeys;
+    for (const std::pair<int, int> &chunk : wantedChunks) {
+        wantedKeys.insert(chunkKey(chunk.first, chunk.second));
+    }
+
+    std::vector<TerrainChunk*> finishedChunks;
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+
+        // jobs that have not started yet are queued again in order of the current camera position
+        for (const std::pair<int, int> &job : jobs) {
+            requestedChunks.erase(chunkKey(job.first, job.second));
+        }
+        jobs.clear();
+
+        for (const std::pair<int, int> &chunk : wantedChunks) {
+            long long key = chunkKey(chunk.first, chunk.second);
+
+            if (chunks.find(key) == chunks.end() && requestedChunks.find(key) == requestedChunks.end()) {
+                jobs.push_back(chunk);
+                requestedChunks.insert(key);
+            }
+        }
+
+        finishedChunks.swap(preparedChunks);
+    }
+    queueCondition.notify_all();
+
+    // upload only a few chunks per frame, nearest first, the others wait for the next frame
+    std::sort(finishedChunks.begin(), finishedChunks.end(),
+              [&](const TerrainChunk *a, const TerrainChunk *b) {
+                  return squaredDistance(a->x, a->y) < squaredDistance(b->x, b->y);
+              });
+
+    std::vector<TerrainChunk*> waitingChunks;
+    unsigned int uploads = 0;
+
+    for (TerrainChunk *chunk : finishedChunks) {
+        long long key = chunkKey(chunk->x, chunk->y);
+
+        if (wantedKeys.find(key) == wantedKeys.end()) {
+            // the camera has moved on in the meantime
+            requestedChunks.erase(key);
+            deleteChunk(chunk);
+
+        } else if (uploads < uploadsPerFrame) {
+            uploadChunk(*chunk);
+            chunks[key] = chunk;
+            requestedChunks.erase(key);
+            ++uploads;
+
+        } else {
+            waitingChunks.push_back(chunk);
+        }
+    }
+
+    if (!waitingChunks.empty()) {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        preparedChunks.insert(preparedChunks.end(), waitingChunks.begin(), waitingChunks.end());
+    }
+
+    // evict the chunks farthest away from the camera while over budget
+    if (chunks.size() > maximumNumberOfChunks) {
+        std::vector<TerrainChunk*> residentChunks;
+        for (auto &entry : chunks) {
+            residentChunks.push_back(entry.second);
+        }
+
+        std::sort(residentChunks.begin(), residentChunks.end(),
+                  [&](const TerrainChunk *a, const TerrainChunk *b) {
+                      return squaredDistance(a->x, a->y) > squaredDistance(b->x, b->y);
+                  });
+
+        for (unsigned int i = 0; chunks.size() > maximumNumberOfChunks; ++i) {
+            chunks.erase(chunkKey(residentChunks[i]->x, residentChunks[i]->y));
+            deleteChunk(residentChunks[i]);
+        }
+    }
+}
+
+void Terrain::rebuildChunk(int x, int y) {
+    TerrainChunk *chunk = getChunk(x, y);
+    if (chunk) {
+        prepareVertices(*chunk);
+        uploadChunk(*chunk);
+    }
+}
+
+void Terrain::updateVertices(TerrainChunk &chunk, int firstX, int firstY, int lastX, int lastY) {
+    std::vector<Vertex> row(lastX - firstX + 1);
+
+    glBindBuffer(GL_ARRAY_BUFFER, chunk.VBO);
+
+    // one upload per row, the rows of a chunk are not contiguous in its vertex buffer
+    for (int y = firstY; y <= lastY; ++y) {
+        for (int x = firstX; x <= lastX; ++x) {
+            row[x - firstX] = computeVertex(chunk, x, y);
+
+            // the bounds only grow, they stay conservative when the terrain is lowered
+            chunk.minimum.y = std::min(chunk.minimum.y, row[x - firstX].position.y);
+            chunk.maximum.y = std::max(chunk.maximum.y, row[x - firstX].position.y);
+        }
+
+        glBufferSubData(GL_ARRAY_BUFFER, (y * (chunkSize + 1) + firstX) * sizeof(Vertex),
+                        row.size() * sizeof(Vertex), row.data());
+    }
+
+    // errors only grow as well, a flattened chunk may keep a finer level than necessary
+    updateErrors(chunk, firstX, firstY, lastX, lastY);
+    updateOccluders(chunk);
+}
+
+bool Terrain::deformHeights(HeightMap &map, int originX, int originY, float x, float y,
+                            float radius, DeformMode mode, float value) const {
+    // grid points of the map within the radius
+    int firstX = std::max((int)std::ceil(x - radius) - originX, 0);
+    int firstY = std::max((int)std::ceil(y - radius) - originY, 0);
+    int lastX = std::min((int)std::floor(x + radius) - originX, map.getWidth() - 1);
+    int lastY = std::min((int)std::floor(y + radius) - originY, map.getDepth() - 1);
+    if (firstX > lastX || firstY > lastY) {
+        return false;
+    }
+
+    for (int gridY = firstY; gridY <= lastY; ++gridY) {
+        for (int gridX = firstX; gridX <= lastX; ++gridX) {
+            float dx = (float)(originX + gridX) - x;
+            float dy = (float)(originY + gridY) - y;
+            float squaredDistance = (dx * dx + dy * dy) / (radius * radius);
+            if (squaredDistance >= 1.0f) {
+                continue;
+            }
+
+            // smooth falloff from the center to the rim
+            float weight = (1.0f - squaredDistance) * (1.0f - squaredDistance);
+            float height = map.getHeightAt(gridX, gridY);
+
+            if (mode == DEFORM_RAISE) {
+                height += weight * value;
+            } else {
+                height += weight * (value - height);
+            }
+
+            map.setHeightAt(gridX, gridY, height);
+        }
+    }
+
+    map.updatePyramid(firstX, firstY, lastX, lastY);
+
+    return true;
+}
+
+void Terrain::deform(float x, float y, float radius, DeformMode mode, float value) {
+    if (radius <= 0.0f) {
+        return;
+    }
+
+    if (!isStreaming()) {
+        deformHeights(*heightMap, 0, 0, x, y, radius, mode, value);
+    }
+
+    // vertices within the radius and their neighbours, whose normals change as well
+    int firstX = (int)std::ceil(x - radius) - 1;
+    int firstY = (int)std::ceil(y - radius) - 1;
+    int lastX = (int)std::floor(x + radius) + 1;
+    int lastY = (int)std::floor(y + radius) + 1;
+
+    // starting one grid point earlier also finds the chunk that has the first vertex on its far border
+    for (int chunkY = chunkCoordinate(firstY - 1, chunkSize); chunkY <= chunkCoordinate(lastY, chunkSize); ++chunkY) {
+        for (int chunkX = chunkCoordinate(firstX - 1, chunkSize); chunkX <= chunkCoordinate(lastX, chunkSize); ++chunkX) {
+            TerrainChunk *chunk = getChunk(chunkX, chunkY);
+            if (!chunk) {
+                continue;
+            }
+
+            // streamed chunks keep their own copy of the heights, including the border
+            if (chunk->heights) {
+                deformHeights(*chunk->heights, chunkX * chunkSize - 1, chunkY * chunkSize - 1,
+                              x, y, radius, mode, value);
+            }
+
+            int localFirstX = std::max(firstX - chunkX * chunkSize, 0);
+            int localFirstY = std::max(firstY - chunkY * chunkSize, 0);
+            int localLastX = std::min(lastX - chunkX * chunkSize, chunkSize);
+            int localLastY = std::min(lastY - chunkY * chunkSize, chunkSize);
+
+            // vertices collapsed onto the border of a bounded terrain follow it
+            if (isBounded() && chunkX * chunkSize + localLastX >= gridWidth - 1) {
+                localLastX = chunkSize;
+            }
+            if (isBounded() && chunkY * chunkSize + localLastY >= gridDepth - 1) {
+                localLastY = chunkSize;
+            }
+
+            if (localFirstX > localLastX || localFirstY > localLastY) {
+                continue;
+            }
+
+            updateVertices(*chunk, localFirstX, localFirstY, localLastX, localLastY);
+        }
+    }
+}
+
+void Terrain::raise(float x, float y, float radius, float amount) {
+    deform(x, y, radius, DEFORM_RAISE, amount);
+}
+
+void Terrain::lower(float x, float y, float radius, float amount) {
+    deform(x, y, radius, DEFORM_RAISE, -amount);
+}
+
+void Terrain::flatten(float x, float y, float radius, float height) {
+    deform(x, y, radius, DEFORM_FLATTEN, height);
+}
+
+TerrainChunk* Terrain::getChunk(int x, int y) {
+    auto entry = chunks.find(chunkKey(x, y));
+    if (entry != chunks.end()) {
+        return entry->second;
+    }
+
+    return nullptr;
+}
+
+void Terrain::selectLevelsOfDetail(const glm::vec3 &cameraPosition, float fov, float viewportHeight) {
+    // size of one world unit in pixels at distance 1
+    float pixelsPerUnit = viewportHeight / (2.0f * std::tan(fov / 2.0f));
+
+    for (auto &entry : chunks) {
+        TerrainChunk &chunk = *entry.second;
+        glm::vec3 closestPoint = glm::clamp(cameraPosition, chunk.minimum, chunk.maximum);
+        float distance = std::max(glm::length(closestPoint - cameraPosition), 0.001f);
+
+        chunk.level = 0;
+        while (chunk.level + 1 < numberOfLevels
+               && chunk.errors[chunk.level + 1] * pixelsPerUnit / distance <= pixelErrorThreshold) {
+            ++chunk.level;
+        }
+    }
+
+    // stitching only works between neighbours whose levels differ by at most one,
+    // so refine chunks next to much finer ones until that holds everywhere
+    bool changed = true;
+    while (changed) {
+        changed = false;
+
+        for (auto &entry : chunks) {
+            TerrainChunk &chunk = *entry.second;
+            TerrainChunk *neighbours[] = {
+                getChunk(chunk.x - 1, chunk.y), getChunk(chunk.x + 1, chunk.y),
+                getChunk(chunk.x, chunk.y - 1), getChunk(chunk.x, chunk.y + 1)
+            };
+
+            for (TerrainChunk *neighbour : neighbours) {
+                if (neighbour && chunk.level > neighbour->level + 1) {
+                    chunk.level = neighbour->level + 1;
+                    changed = true;
+                }
+            }
+        }
+    }
+}
+
+int Terrain::getStitchedEdges(const TerrainChunk &chunk) {
+    int stitchedEdges = 0;
+
+    TerrainChunk *left = getChunk(chunk.x - 1, chunk.y);
+    TerrainChunk *right = getChunk(chunk.x + 1, chunk.y);
+    TerrainChunk *bottom = getChunk(chunk.x, chunk.y - 1);
+    TerrainChunk *top = getChunk(chunk.x, chunk.y + 1);
+
+    if (left && left->level > chunk.level) {
+        stitchedEdges |= EDGE_LEFT;
+    }
+    if (right && right->level > chunk.level) {
+        stitchedEdges |= EDGE_RIGHT;
+    }
+    if (bottom && bottom->level > chunk.level) {
+        stitchedEdges |= EDGE_BOTTOM;
+    }
+    if (top && top->level > chunk.level) {
+        stitchedEdges |= EDGE_TOP;
+    }
+
+    return stitchedEdges;
+}
+
+void Terrain::cull(const Frustum &frustum) {
+    chunkList.clear();
+    for (auto &entry : chunks) {
+        chunkList.push_back(entry.second);
+    }
+    chunkBounds.resize(chunkList.size());
+    for (unsigned int i = 0; i < chunkList.size(); ++i) {
+        chunkBounds.set(i, chunkList[i]->minimum, chunkList[i]->maximum);
+    }
+    frustum.testBoxes(chunkBounds, chunkVisible);
+}
+
+void Terrain::drawOccluders(OcclusionBuffer &buffer) const {
+    for (unsigned int i = 0; i < chunkList.size(); ++i) {
+        if (!chunkVisible[i]) {
+            continue;
+        }
+        const TerrainChunk &chunk = *chunkList[i];
+
+        // the drawn triangles of a level stay within the squares of the next coarser level,
+        // also those stitched to a coarser neighbour
+        int level = std::min(std::max(chunk.level + 1, firstOccluderLevel), numberOfLevels - 1);
+        const std::vector<float> &lowest = chunk.occluderHeights[level - firstOccluderLevel];
+        int step = 1 << level;
+        int squares = chunkSize >> level;
+
+        // a grid point is not higher than any of its squares, so the triangles between
+        // the grid points are below all that is drawn in their square
+        occluderPositions.resize((squares + 1) * (squares + 1));
+        for (int y = 0; y <= squares; ++y) {
+            for (int x = 0; x <= squares; ++x) {
+                float height = std::numeric_limits<float>::infinity();
+                for (int squareY = std::max(y - 1, 0); squareY <= std::min(y, squares - 1); ++squareY) {
+                    for (int squareX = std::max(x - 1, 0); squareX <= std::min(x, squares - 1); ++squareX) {
+                        height = std::min(height, lowest[squareY * squares + squareX]);
+                    }
+                }
+
+                int worldX = chunk.x * chunkSize + x * step;
+                int worldY = chunk.y * chunkSize + y * step;
+                if (isBounded()) {
+                    worldX = std::min(worldX, gridWidth - 1);
+                    worldY = std::min(worldY, gridDepth - 1);
+                }
+                occluderPositions[y * (squares + 1) + x] = glm::vec3((float)worldX, height, (float)worldY);
+            }
+        }
+
+        for (int y = 0; y < squares; ++y) {
+            for (int x = 0; x < squares; ++x) {
+                const glm::vec3 *lower = &occluderPositions[y * (squares + 1) + x];
+                const glm::vec3 *upper = lower + squares + 1;
+                buffer.drawTriangle(lower[0], upper[0], lower[1]);
+                buffer.drawTriangle(upper[0], lower[1], upper[1]);
+            }
+        }
+    }
+}
+
+void Terrain::draw(Shader &shader, const OcclusionBuffer &occlusion) {
+    shader.use();
+    shader.setModelMatrix(glm::mat4(1.0f));
+
+    // the same textures for all chunks
+    for (unsigned int i = 0; i < textures.size(); ++i) {
+        glActiveTexture(GL_TEXTURE0 + i);
+        shader.setInt(shader.getUniformLocation(samplerNames[i]), i);
+        glBindTexture(GL_TEXTURE_2D, textures[i].id);
+    }
+
+    drawnTriangles = 0;
+    drawnChunks = 0;
+    occludedChunks = 0;
+
+    for (unsigned int i = 0; i < chunkList.size(); ++i) {
+        if (!chunkVisible[i]) {
+            continue;
+        }
+
+        const TerrainChunk &chunk = *chunkList[i];
+        // hidden behind other chunks, the own occluder of a chunk is within its bounds
+        if (occlusion.isBoxOccluded(chunk.minimum, chunk.maximum)) {
+            ++occludedChunks;
+            continue;
+        }
+        const IndexRange &range = indexRanges[chunk.level * NUMBER_OF_EDGE_COMBINATIONS + getStitchedEdges(chunk)];
+
+        glBindVertexArray(chunk.VAO);
+        glDrawElements(GL_TRIANGLES, range.count, GL_UNSIGNED_INT, (void*)(uintptr_t)range.offset);
+
+        drawnTriangles += range.count / 3;
+        ++drawnChunks;
+    }
+
+    glBindVertexArray(0);
+}
+
+float Terrain::getHeight(float x, float y) const {
+    if (!isStreaming()) {
+        return heightMap->getHeight(x, y);
+    }
+
+    if (isBounded() && (x < 0 || y < 0 || x > gridWidth - 1 || y > gridDepth - 1)) {
+        return -std::numeric_limits<float>::infinity();
+    }
+
+    int xInt = (int)std::floor(x);
+    int yInt = (int)std::floor(y);
+    int chunkX = chunkCoordinate(xInt, chunkSize);
+    int chunkY = chunkCoordinate(yInt, chunkSize);
+
+    auto entry = chunks.find(chunkKey(chunkX, chunkY));
+    if (entry != chunks.end()) {
+        // the generated heights start one sample before the chunk
+        return entry->second->heights->getHeight(x - chunkX * chunkSize + 1, y - chunkY * chunkSize + 1);
+    }
+
+    // not loaded (yet), generate just the corners of the square around the position
+    float corners[4];
+    generator(xInt, yInt, 2, 2, corners);
+
+    float s = x - (float)xInt;
+    float t = y - (float)yInt;
+    return (1 - t) * ((1 - s) * corners[0] + s * corners[1]) + t * ((1 - s) * corners[2] + s * corners[3]);
+}
+
+void Terrain::getHeights(const float *xs, const float *ys, float *results, int count) const {
+    if (!isStreaming()) {
+        heightMap->getHeights(xs, ys, results, count);
+        return;
+    }
+
+    // streamed heights are spread over the chunks
+    for (int i = 0; i < count; ++i) {
+        results[i] = getHeight(xs[i], ys[i]);
+    }
+}
+
+TerrainHit Terrain::raycast(const glm::vec3 &origin, const glm::vec3 &direction, float maximumDistance) const {
+    if (!isStreaming()) {
+        return heightMap->raycast(origin, direction, maximumDistance);
+    }
+
+    TerrainHit hit;
+    if (glm::length(direction) == 0.0f) {
+        return hit;
+    }
+    glm::vec3 normalizedDirection = glm::normalize(direction);
+
+    // walk along the chunks that the ray crosses, nearest first
+    int chunkX = chunkCoordinate((int)std::floor(origin.x), chunkSize);
+    int chunkY = chunkCoordinate((int)std::floor(origin.z), chunkSize);
+    int stepX = (normalizedDirection.x >= 0.0f) ? 1 : -1;
+    int stepY = (normalizedDirection.z >= 0.0f) ? 1 : -1;
+
+    // distances to the next chunk border along x and y, and between two borders
+    float infinity = std::numeric_limits<float>::infinity();
+    float nextBorderX = (float)((chunkX + (stepX > 0 ? 1 : 0)) * chunkSize);
+    float nextBorderY = (float)((chunkY + (stepY > 0 ? 1 : 0)) * chunkSize);
+    float distanceX = (normalizedDirection.x != 0.0f) ? (nextBorderX - origin.x) / normalizedDirection.x : infinity;
+    float distanceY = (normalizedDirection.z != 0.0f) ? (nextBorderY - origin.z) / normalizedDirection.z : infinity;
+    float deltaX = (normalizedDirection.x != 0.0f) ? chunkSize / std::abs(normalizedDirection.x) : infinity;
+    float deltaY = (normalizedDirection.z != 0.0f) ? chunkSize / std::abs(normalizedDirection.z) : infinity;
+
+    // beyond the load radius no chunks are resident
+    int maximumSteps = 4 * (loadRadius + 1);
+    float distance = 0.0f;
+
+    for (int step = 0; step < maximumSteps && distance <= maximumDistance; ++step) {
+        auto entry = chunks.find(chunkKey(chunkX, chunkY));
+        if (entry != chunks.end()) {
+            // the heights of a chunk start one sample before it
+            glm::vec3 offset((float)(chunkX * chunkSize - 1), 0.0f, (float)(chunkY * chunkSize - 1));
+
+            hit = entry->second->heights->raycast(origin - offset, normalizedDirection, maximumDistance);
+            if (hit.hit) {
+                hit.position += offset;
+                return hit;
+            }
+        }
+
+        if (distanceX < distanceY) {
+            distance = distanceX;
+            distanceX += deltaX;
+            chunkX += stepX;
+        } else {
+            distance = distanceY;
+            distanceY += deltaY;
+            chunkY += stepY;
+        }
+    }
+
+    return hit;
+}
+
+void Terrain::setPixelErrorThreshold(float threshold) {
+    pixelErrorThreshold = threshold;
+}
+
+void Terrain::setLoadRadius(int radius) {
+    loadRadius = radius;
+}
+
+void Terrain::setMemoryBudget(unsigned int bytes) {
+    // GPU vertices and generated heights of one chunk
+    unsigned int bytesPerChunk = (chunkSize + 1) * (chunkSize + 1) * sizeof(Vertex)
+                                 + (chunkSize + 3) * (chunkSize + 3) * sizeof(float);
+
+    maximumNumberOfChunks = std::max(1u, bytes / bytesPerChunk);
+}
+
+void Terrain::setBounds(int width, int depth) {
+    gridWidth = width;
+    gridDepth = depth;
+}
+
+bool Terrain::isBounded() const {
+    return gridWidth > 0;
+}
+
+bool Terrain::isChunkInBounds(int x, int y) const {
+    // a chunk is needed as long as its first grid point has a square after it
+    return !isBounded() || (x >= 0 && y >= 0 && x * chunkSize < gridWidth - 1 && y * chunkSize < gridDepth - 1);
+}
+
+bool Terrain::isStreaming() const {
+    return heightMap == nullptr;
+}
+
+int Terrain::getChunkSize() const {
+    return chunkSize;
+}
+
+unsigned int Terrain::getNumberOfChunks() const {
+    return chunks.size();
+}
+
+unsigned int Terrain::getNumberOfDrawnTriangles() const {
+    return drawnTriangles;
+}
+
+unsigned int Terrain::getNumberOfDrawnChunks() const {
+    return drawnChunks;
+}
+
+unsigned int Terrain::getNumberOfOccludedChunks() const {
+    return occludedChunks;
+}
@@ -0,0 +1,224 @@
+#ifndef TERRAIN_H
+#define TERRAIN_H
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <limits>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "frustum.h"
+#include "heightmap.h"
+#include "mesh.h"
+#include "occlusion.h"
+#include "shader.h"
+#include "texture.h"
+
+// square part of the terrain with its own vertex buffer
+struct TerrainChunk {
+    // chunk coordinates
+    int x;
+    int y;
+
+    unsigned int VAO; // vertex attribute object
+    unsigned int VBO; // vertex buffer object
+
+    // axis-aligned bounding box in world space
+    glm::vec3 minimum;
+    glm::vec3 maximum;
+
+    // maximum height error of each level of detail compared to full resolution
+    std::vector<float> errors;
+    // lowest height of the squares of each level of detail from the first occluder level on,
+    // nothing that is drawn in a square at that level or a finer one lies below it
+    std::vector<std::vector<float>> occluderHeights;
+    // currently selected level of detail
+    int level;
+
+    // generated heights of the chunk plus a border of one sample for the normals
+    // (only for generated chunks, finite terrains read from their height map)
+    HeightMap *heights;
+    // vertices prepared by a worker thread that still have to be uploaded
+    std::vector<Vertex> vertices;
+};
+
+// part of the shared index buffer
+struct IndexRange {
+    unsigned int offset; // in bytes
+    unsigned int count;
+};
+
+// renders a height map as a grid of independently built chunks, either all chunks of a
+// finite height map or an unbounded terrain whose chunks are generated around the camera
+class Terrain {
+private:
+    // finite terrain: every chunk comes from this height map
+    HeightMap *heightMap;
+    // unbounded terrain: chunks are generated on demand
+    HeightGenerator generator;
+
+    // number of grid points of a bounded terrain, 0 if unbounded
+    int gridWidth;
+    int gridDepth;
+
+    // number of squares along each side of a chunk
+    int chunkSize;
+    std::unordered_map<long long, TerrainChunk*> chunks;
+
+    // every chunk has the same grid topology, so all of them share one index buffer
+    // with one range per level of detail and combination of stitched edges
+    unsigned int EBO;
+    int numberOfLevels;
+    std::vector<IndexRange> indexRanges;
+
+    // maximum tolerated height error on screen (in pixels)
+    float pixelErrorThreshold;
+    unsigned int drawnTriangles;
+
+    // bounds of the resident chunks for culling, rebuilt every frame
+    std::vector<TerrainChunk*> chunkList;
+    BoundingBoxes chunkBounds;
+    std::vector<unsigned char> chunkVisible;
+    unsigned int drawnChunks;
+    unsigned int occludedChunks;
+
+    // occluders are not finer than this level of detail
+    int firstOccluderLevel;
+    // grid points of the occluder of one chunk, kept for the next chunk and frame
+    mutable std::vector<glm::vec3> occluderPositions;
+
+    std::vector<Texture> textures;
+    // sampler uniforms the textures are bound to
+    std::vector<std::string> samplerNames;
+
+    // streaming: chunks within the load radius (in chunks) are generated,
+    // the farthest ones are evicted once more chunks than the budget allows are loaded
+    int loadRadius;
+    unsigned int maximumNumberOfChunks;
+    unsigned int uploadsPerFrame;
+    std::unordered_set<long long> requestedChunks;
+
+    // worker threads and the queues shared with them
+    std::vector<std::thread> workers;
+    std::mutex queueMutex;
+    std::condition_variable queueCondition;
+    std::deque<std::pair<int, int>> jobs;
+    std::vector<TerrainChunk*> preparedChunks;
+    bool stopWorkers;
+
+    static long long chunkKey(int x, int y);
+    static int chunkCoordinate(int position, int chunkSize);
+
+    void setUp();
+    void setUpIndices();
+    void generateIndices(int level, int stitchedEdges, std::vector<unsigned int> &indices) const;
+
+    // CPU part of building a chunk, safe to run on a worker thread
+    TerrainChunk* prepareChunk(int x, int y) const;
+    void prepareVertices(TerrainChunk &chunk) const;
+    Vertex computeVertex(const TerrainChunk &chunk, int x, int y) const;
+    // recompute the errors of the levels of detail for the changed vertices (in chunk coordinates)
+    void updateErrors(TerrainChunk &chunk, int firstX, int firstY, int lastX, int lastY) const;
+    // recompute the occluder heights of all squares of the chunk
+    void updateOccluders(TerrainChunk &chunk) const;
+    float chunkHeight(const TerrainChunk &chunk, int x, int y) const;
+    glm::vec3 chunkNormal(const TerrainChunk &chunk, int x, int y) const;
+
+    // GL part of building a chunk, only on the render thread
+    void uploadChunk(TerrainChunk &chunk);
+    void deleteChunk(TerrainChunk *chunk);
+    // upload only the changed vertices (in chunk coordinates) of a resident chunk
+    void updateVertices(TerrainChunk &chunk, int firstX, int firstY, int lastX, int lastY);
+
+    enum DeformMode {
+        DEFORM_RAISE,  // add the value
+        DEFORM_FLATTEN // move towards the value
+    };
+    // deform the heights of a map whose first grid point is (originX, originY)
+    bool deformHeights(HeightMap &map, int originX, int originY, float x, float y,
+                       float radius, DeformMode mode, float value) const;
+    void deform(float x, float y, float radius, DeformMode mode, float value);
+
+    void runWorker();
+    void startWorkers();
+    void stopAllWorkers();
+
+    bool isChunkInBounds(int x, int y) const;
+    TerrainChunk* getChunk(int x, int y);
+    int getStitchedEdges(const TerrainChunk &chunk);
+
+public:
+    static const int DEFAULT_CHUNK_SIZE = 64;
+    static const int DEFAULT_LOAD_RADIUS = 6;
+    static const unsigned int DEFAULT_MEMORY_BUDGET = 64 * 1024 * 1024;
+
+    // edges of a chunk that border a chunk with a coarser level of detail
+    enum Edge {
+        EDGE_LEFT   = 1 << 0,
+        EDGE_RIGHT  = 1 << 1,
+        EDGE_BOTTOM = 1 << 2,
+        EDGE_TOP    = 1 << 3
+    };
+    static const int NUMBER_OF_EDGE_COMBINATIONS = 16;
+
+    // finite terrain made from all of the height map
+    Terrain(HeightMap &heightMap, int chunkSize = DEFAULT_CHUNK_SIZE);
+    // unbounded terrain, generated around the camera on worker threads
+    Terrain(HeightGenerator generator, int chunkSize = DEFAULT_CHUNK_SIZE);
+    ~Terrain();
+
+    Terrain(const Terrain&) = delete;
+    Terrain& operator=(const Terrain&) = delete;
+
+    // request chunks around the camera, upload finished ones, and evict distant ones
+    void update(const glm::vec3 &cameraPosition);
+    // upload the current heights of a chunk again
+    void rebuildChunk(int x, int y);
+
+    // edit the heights within a radius around (x, y) with a smooth falloff towards the rim,
+    // only the affected vertices are recomputed and uploaded (edits of a streamed terrain
+    // are lost when their chunks are evicted)
+    void raise(float x, float y, float radius, float amount);
+    void lower(float x, float y, float radius, float amount);
+    void flatten(float x, float y, float radius, float height);
+
+    // choose the coarsest level of detail of each chunk whose error stays below the threshold on screen
+    void selectLevelsOfDetail(const glm::vec3 &cameraPosition, float fov, float viewportHeight);
+    // select the chunks whose bounding boxes are within the frustum for this frame
+    void cull(const Frustum &frustum);
+    // draw a coarse version of the selected chunks that lies below the drawn terrain,
+    // so that it only hides what the terrain hides
+    void drawOccluders(OcclusionBuffer &buffer) const;
+    // draw the selected chunks that are not hidden behind the occluders
+    void draw(Shader &shader, const OcclusionBuffer &occlusion);
+
+    // bilinearly interpolated height, -infinity outside of a bounded terrain
+    float getHeight(float x, float y) const;
+    // the same for count positions at once, results[i] is the height at (xs[i], ys[i])
+    void getHeights(const float *xs, const float *ys, float *results, int count) const;
+    // first intersection of the ray with the terrain within maximumDistance,
+    // a streamed terrain only knows the chunks that are currently loaded
+    TerrainHit raycast(const glm::vec3 &origin, const glm::vec3 &direction,
+                       float maximumDistance = std::numeric_limits<float>::infinity()) const;
+
+    void setPixelErrorThreshold(float threshold);
+    void setLoadRadius(int radius);
+    void setMemoryBudget(unsigned int bytes);
+    // restrict a streamed terrain to the grid points [0, width) x [0, depth)
+    void setBounds(int width, int depth);
+    bool isBounded() const;
+    bool isStreaming() const;
+    int getChunkSize() const;
+    unsigned int getNumberOfChunks() const;
+    unsigned int getNumberOfDrawnTriangles() const;
+    unsigned int getNumberOfDrawnChunks() const;
+    unsigned int getNumberOfOccludedChunks() const;
+};
+
+#endif
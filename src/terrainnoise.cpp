@@ -0,0 +1,215 @@
+#include "terrainnoise.h"
+
+#include <algorithm>
+#include <cmath>
+#include <thread>
+#include <vector>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// grids with at least this many points are generated on all cores
+static const int PARALLEL_GENERATION_THRESHOLD = 64 * 1024;
+
+static const uint32_t OCTAVE_SEED_OFFSET = 0x9e3779b9u;
+
+// integer hash of a lattice point, the SIMD version below has to compute exactly the same
+static inline uint32_t hashLatticePoint(int x, int y, uint32_t seed) {
+    uint32_t hash = ((uint32_t)x * 0x8da6b343u) ^ ((uint32_t)y * 0xd8163841u) ^ seed;
+    hash ^= hash >> 15;
+    hash *= 0x2c1b3c6du;
+    hash ^= hash >> 12;
+    hash *= 0x297a2d39u;
+    hash ^= hash >> 15;
+    return hash;
+}
+
+// pseudo-random gradient of a lattice point
+static inline void latticeGradient(int x, int y, uint32_t seed, float &gx, float &gy) {
+    uint32_t hash = hashLatticePoint(x, y, seed);
+    gx = (float)(int)(hash & 0xffffu) * (1.0f / 32768.0f) - 1.0f;
+    gy = (float)(int)(hash >> 16) * (1.0f / 32768.0f) - 1.0f;
+}
+
+// quintic interpolation curve, its first and second derivatives vanish at 0 and 1
+static inline float fade(float t) {
+    return t * t * t * (t * (t * 6.0f - 15.0f) + 10.0f);
+}
+
+#ifdef __SSE2__
+static inline __m128 fades(__m128 t) {
+    __m128 inner = _mm_add_ps(_mm_mul_ps(t, _mm_sub_ps(_mm_mul_ps(t, _mm_set1_ps(6.0f)), _mm_set1_ps(15.0f))),
+                              _mm_set1_ps(10.0f));
+    return _mm_mul_ps(_mm_mul_ps(_mm_mul_ps(t, t), t), inner);
+}
+#endif
+
+TerrainNoise::TerrainNoise(uint32_t seed)
+    : seed(seed),
+      octaves(6),
+      frequency(1.0f / 128.0f),
+      amplitude(24.0f),
+      lacunarity(2.0f),
+      gain(0.5f) {
+}
+
+uint32_t TerrainNoise::getSeed() const {
+    return seed;
+}
+
+void TerrainNoise::setOctaves(int octaves, float lacunarity, float gain) {
+    this->octaves = octaves;
+    this->lacunarity = lacunarity;
+    this->gain = gain;
+}
+
+void TerrainNoise::setFrequency(float frequency) {
+    this->frequency = frequency;
+}
+
+void TerrainNoise::setAmplitude(float amplitude) {
+    this->amplitude = amplitude;
+}
+
+void TerrainNoise::noiseRow(int originX, float y, float frequency, uint32_t octaveSeed, float scale,
+                            int count, float *heights, std::vector<float> &columns) const {
+    float lowerY = std::floor(y);
+    int iy = (int)lowerY;
+    float dy = y - lowerY;
+    float t = fade(dy);
+
+    // all positions of the row lie between the same two lattice rows, so the vertical
+    // interpolation is done once per lattice column: the noise left of x is a * dx + b
+    int firstColumn = (int)std::floor((float)originX * frequency);
+    int lastColumn = (int)std::floor((float)(originX + count - 1) * frequency) + 1;
+
+    // per column: a and b of the column itself and of the next one
+    columns.resize(4 * (lastColumn - firstColumn));
+    for (int column = firstColumn; column <= lastColumn; ++column) {
+        float lowerGX, lowerGY, upperGX, upperGY;
+        latticeGradient(column, iy, octaveSeed, lowerGX, lowerGY);
+        latticeGradient(column, iy + 1, octaveSeed, upperGX, upperGY);
+
+        float a = (1.0f - t) * lowerGX + t * upperGX;
+        float b = (1.0f - t) * lowerGY * dy + t * upperGY * (dy - 1.0f);
+
+        int index = 4 * (column - firstColumn);
+        if (column < lastColumn) {
+            columns[index] = a;
+            columns[index + 1] = b;
+        }
+        if (index > 0) {
+            columns[index - 2] = a;
+            columns[index - 1] = b;
+        }
+    }
+
+    int i = 0;
+
+#ifdef __SSE2__
+    __m128 one = _mm_set1_ps(1.0f);
+    __m128 scales = _mm_set1_ps(scale);
+    __m128 frequencies = _mm_set1_ps(frequency);
+    __m128i offsets = _mm_setr_epi32(0, 1, 2, 3);
+    __m128i firstColumns = _mm_set1_epi32(firstColumn);
+
+    for (; i + 4 <= count; i += 4) {
+        // same as (float)(originX + i) * frequency in the scalar loop
+        __m128 xs = _mm_mul_ps(_mm_cvtepi32_ps(_mm_add_epi32(_mm_set1_epi32(originX + i), offsets)), frequencies);
+
+        // floor: truncate, then correct negative values with a fractional part
+        __m128i truncated = _mm_cvttps_epi32(xs);
+        __m128 lowerX = _mm_cvtepi32_ps(truncated);
+        __m128 tooLarge = _mm_cmpgt_ps(lowerX, xs);
+        lowerX = _mm_sub_ps(lowerX, _mm_and_ps(tooLarge, one));
+        __m128i ix = _mm_add_epi32(truncated, _mm_castps_si128(tooLarge));
+
+        int indices[4];
+        _mm_storeu_si128((__m128i*)indices, _mm_sub_epi32(ix, firstColumns));
+
+        // one load per lane, then transpose into a, b, a of the next column, b of the next column
+        __m128 a = _mm_loadu_ps(&columns[4 * indices[0]]);
+        __m128 b = _mm_loadu_ps(&columns[4 * indices[1]]);
+        __m128 nextA = _mm_loadu_ps(&columns[4 * indices[2]]);
+        __m128 nextB = _mm_loadu_ps(&columns[4 * indices[3]]);
+        _MM_TRANSPOSE4_PS(a, b, nextA, nextB);
+
+        __m128 dx = _mm_sub_ps(xs, lowerX);
+        __m128 left = _mm_add_ps(_mm_mul_ps(a, dx), b);
+        __m128 right = _mm_add_ps(_mm_mul_ps(nextA, _mm_sub_ps(dx, one)), nextB);
+        __m128 value = _mm_add_ps(left, _mm_mul_ps(fades(dx), _mm_sub_ps(right, left)));
+
+        _mm_storeu_ps(heights + i, _mm_add_ps(_mm_loadu_ps(heights + i), _mm_mul_ps(scales, value)));
+    }
+#endif
+
+    // remaining positions (or all of them without SSE2)
+    for (; i < count; ++i) {
+        float x = (float)(originX + i) * frequency;
+        float lowerX = std::floor(x);
+        const float *column = &columns[4 * ((int)lowerX - firstColumn)];
+
+        float dx = x - lowerX;
+        float left = column[0] * dx + column[1];
+        float right = column[2] * (dx - 1.0f) + column[3];
+        float value = left + fade(dx) * (right - left);
+
+        heights[i] += scale * value;
+    }
+}
+
+float TerrainNoise::getHeight(int x, int y) const {
+    float height = 0.0f;
+    generate(x, y, 1, 1, &height);
+    return height;
+}
+
+void TerrainNoise::generateRow(int originX, int y, int count, float *heights,
+                               std::vector<float> &columns) const {
+    std::fill(heights, heights + count, 0.0f);
+
+    float octaveFrequency = frequency;
+    float octaveAmplitude = amplitude;
+    uint32_t octaveSeed = seed;
+
+    for (int octave = 0; octave < octaves; ++octave) {
+        noiseRow(originX, (float)y * octaveFrequency, octaveFrequency, octaveSeed, octaveAmplitude,
+                 count, heights, columns);
+
+        octaveFrequency *= lacunarity;
+        octaveAmplitude *= gain;
+        octaveSeed += OCTAVE_SEED_OFFSET;
+    }
+}
+
+void TerrainNoise::generate(int originX, int originY, int width, int depth, float *heights) const {
+    auto generateRows = [=](int firstRow, int lastRow) {
+        // one scratch buffer per thread, the terrain workers and the main thread keep theirs
+        // over all calls, so that small patches and single squares do not allocate
+        static thread_local std::vector<float> columns;
+        for (int y = firstRow; y < lastRow; ++y) {
+            generateRow(originX, originY + y, width, heights + y * width, columns);
+        }
+    };
+
+    unsigned int numberOfThreads = std::max(1u, std::thread::hardware_concurrency());
+    if (width * depth < PARALLEL_GENERATION_THRESHOLD || numberOfThreads == 1) {
+        generateRows(0, depth);
+        return;
+    }
+
+    // every row is independent, so each thread gets a contiguous block of rows
+    numberOfThreads = std::min(numberOfThreads, (unsigned int)depth);
+    std::vector<std::thread> threads;
+
+    for (unsigned int i = 0; i < numberOfThreads; ++i) {
+        int firstRow = depth * i / numberOfThreads;
+        int lastRow = depth * (i + 1) / numberOfThreads;
+        threads.push_back(std::thread(generateRows, firstRow, lastRow));
+    }
+
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+}
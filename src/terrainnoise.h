@@ -0,0 +1,44 @@
+#ifndef TERRAINNOISE_H
+#define TERRAINNOISE_H
+
+#include <cstdint>
+#include <vector>
+
+// seeded fractal gradient noise, every height depends only on its position and the seed,
+// so any part of the terrain can be generated independently and reproduced later
+class TerrainNoise {
+private:
+    uint32_t seed;
+
+    int octaves;
+    float frequency;  // of the first octave, in cycles per grid square
+    float amplitude;  // of the first octave
+    float lacunarity; // frequency factor from one octave to the next
+    float gain;       // amplitude factor from one octave to the next
+
+    // adds scale times the gradient noise (roughly within [-1, 1]) of grid points
+    // (originX + i, y) for i < count, with y already multiplied by the frequency
+    void noiseRow(int originX, float y, float frequency, uint32_t octaveSeed, float scale,
+                  int count, float *heights, std::vector<float> &columns) const;
+
+public:
+    static const uint32_t DEFAULT_SEED = 1;
+
+    TerrainNoise(uint32_t seed = DEFAULT_SEED);
+
+    uint32_t getSeed() const;
+    void setOctaves(int octaves, float lacunarity = 2.0f, float gain = 0.5f);
+    void setFrequency(float frequency);
+    void setAmplitude(float amplitude);
+
+    // height of grid point (x, y)
+    float getHeight(int x, int y) const;
+    // heights of grid points (originX + i, y) for i < count, columns is scratch memory
+    // that is reused from one row to the next
+    void generateRow(int originX, int y, int count, float *heights, std::vector<float> &columns) const;
+    // heights of width x depth grid points starting at (originX, originY), row-major,
+    // large grids are split into rows on all cores
+    void generate(int originX, int originY, int width, int depth, float *heights) const;
+};
+
+#endif
@@ -0,0 +1,21 @@
+#include "uniformbuffer.h"
+
+UniformBuffer::UniformBuffer(GLuint bindingPoint, GLsizeiptr size)
+    : size(size) {
+    glGenBuffers(1, &UBO);
+    glBindBuffer(GL_UNIFORM_BUFFER, UBO);
+    glBufferData(GL_UNIFORM_BUFFER, size, nullptr, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+    glBindBufferBase(GL_UNIFORM_BUFFER, bindingPoint, UBO);
+}
+
+UniformBuffer::~UniformBuffer() {
+    glDeleteBuffers(1, &UBO);
+}
+
+void UniformBuffer::update(const void *data) {
+    glBindBuffer(GL_UNIFORM_BUFFER, UBO);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, size, data);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
@@ -0,0 +1,83 @@
+#ifndef UNIFORMBUFFER_H
+#define UNIFORMBUFFER_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+// binding points of the uniform blocks shared by the shaders
+static const GLuint CAMERA_BLOCK_BINDING = 0;
+static const GLuint LIGHTS_BLOCK_BINDING = 1;
+
+// has to match MAX_POINT_LIGHTS in shaders/lights.glsl
+static const int MAX_POINT_LIGHTS = 4;
+
+// the structs below mirror the std140 layout of the uniform blocks in the shaders,
+// a vec3 takes 16 bytes there, so the shaders put a float into the last 4 bytes where they can
+
+// uniform block "Camera"
+struct CameraBlock {
+    glm::mat4 view;
+    glm::mat4 projection;
+};
+
+struct DirectionalLightBlock {
+    glm::vec3 direction;
+    float padding0;
+    glm::vec3 ambient;
+    float padding1;
+    glm::vec3 diffuse;
+    float padding2;
+    glm::vec3 specular;
+    float padding3;
+};
+
+struct PointLightBlock {
+    glm::vec3 position;
+    float constant;
+    glm::vec3 ambient;
+    float linear;
+    glm::vec3 diffuse;
+    float quadratic;
+    glm::vec3 specular;
+    float padding;
+};
+
+struct SpotLightBlock {
+    glm::vec3 position;
+    float cutOff;
+    glm::vec3 direction;
+    float outerCutOff;
+    glm::vec3 ambient;
+    float constant;
+    glm::vec3 diffuse;
+    float linear;
+    glm::vec3 specular;
+    float quadratic;
+};
+
+// uniform block "Lights", positions and directions in view space
+struct LightsBlock {
+    DirectionalLightBlock directionalLight;
+    PointLightBlock pointLights[MAX_POINT_LIGHTS];
+    SpotLightBlock spotLight;
+};
+
+// uniform buffer object attached to a binding point, shared by all shaders
+// whose uniform block is bound to the same point
+class UniformBuffer {
+private:
+    unsigned int UBO;
+    GLsizeiptr size;
+
+public:
+    UniformBuffer(GLuint bindingPoint, GLsizeiptr size);
+    ~UniformBuffer();
+
+    UniformBuffer(const UniformBuffer&) = delete;
+    UniformBuffer& operator=(const UniformBuffer&) = delete;
+
+    // replace the whole content of the buffer
+    void update(const void *data);
+};
+
+#endif